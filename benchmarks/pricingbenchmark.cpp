@@ -0,0 +1,212 @@
+// Times repricing every client at 10k, 100k and 1M clients, four ways:
+//   map rows     per-client pricing, supplement quantities in a QMap per client
+//   inline rows  the same loop, quantities inline in a QVarLengthArray
+//   kernel       PricingKernel over column arrays, building the columns included
+//   kernel only  PricingKernel over columns built beforehand
+// All four must agree on every price; the run fails otherwise.
+//
+// Usage: PricingBenchmark [client counts...]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+#include "pricingkernel.h"
+
+// Best of this many runs is reported, the first one warms the caches
+static const int Repeats = 5;
+
+// As many as the client dialog offers
+static const int OfferCount = 3;
+static const int SupplementCount = 9;
+
+struct MapClient {
+    int offer;
+    int discount;
+    QMap<int, int> supplements;
+};
+
+struct InlineClient {
+    int offer;
+    int discount;
+    QVarLengthArray<quint16, 16> supplements;
+};
+
+struct Dataset {
+    PricingKernel::PriceTable table;
+    QList<MapClient> mapClients;
+    QList<InlineClient> inlineClients;
+};
+
+static Dataset generate(int count)
+{
+    // Fixed seed, every run prices the same clients
+    QRandomGenerator random(20240601);
+    Dataset dataset;
+
+    for (int id = 0; id < OfferCount; ++id) {
+        dataset.table.offerPrices.append(random.bounded(1000, 5000));
+    }
+    for (int id = 0; id < SupplementCount; ++id) {
+        dataset.table.supplementPrices.append(random.bounded(50, 500));
+    }
+
+    dataset.mapClients.reserve(count);
+    dataset.inlineClients.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        MapClient mapClient{random.bounded(OfferCount), random.bounded(31), {}};
+        InlineClient inlineClient{mapClient.offer, mapClient.discount, {}};
+
+        // About a third of the supplements taken, one to three of each
+        for (int suppId = 0; suppId < SupplementCount; ++suppId) {
+            if (random.bounded(3) != 0)
+                continue;
+
+            int quantity = random.bounded(1, 4);
+            mapClient.supplements.insert(suppId, quantity);
+            inlineClient.supplements.resize(suppId + 1, 0);
+            inlineClient.supplements[suppId] = quint16(quantity);
+        }
+
+        dataset.mapClients.append(mapClient);
+        dataset.inlineClients.append(inlineClient);
+    }
+    return dataset;
+}
+
+static int offerPrice(const PricingKernel::PriceTable &table, int offer)
+{
+    return (offer >= 0 && offer < table.offerPrices.size()) ? table.offerPrices.at(offer) : 0;
+}
+
+static QList<int> priceMapRows(const PricingKernel::PriceTable &table, const QList<MapClient> &clients)
+{
+    QList<int> prices;
+    prices.reserve(clients.size());
+    for (const MapClient &client : clients) {
+        int total = offerPrice(table, client.offer);
+        for (auto it = client.supplements.cbegin(); it != client.supplements.cend(); ++it) {
+            if (it.key() < table.supplementPrices.size()) {
+                total += table.supplementPrices.at(it.key()) * it.value();
+            }
+        }
+        prices.append(total * (100 - client.discount) / 100);
+    }
+    return prices;
+}
+
+static QList<int> priceInlineRows(const PricingKernel::PriceTable &table, const QList<InlineClient> &clients)
+{
+    QList<int> prices;
+    prices.reserve(clients.size());
+    for (const InlineClient &client : clients) {
+        int total = offerPrice(table, client.offer);
+        int held = qMin(int(client.supplements.size()), int(table.supplementPrices.size()));
+        for (int suppId = 0; suppId < held; ++suppId) {
+            total += table.supplementPrices.at(suppId) * client.supplements.at(suppId);
+        }
+        prices.append(total * (100 - client.discount) / 100);
+    }
+    return prices;
+}
+
+static PricingKernel::Columns buildColumns(const PricingKernel::PriceTable &table, const QList<InlineClient> &clients)
+{
+    // Laid out the way ClientModel::recalculateAllPrices does it
+    int supplementCount = table.supplementPrices.size();
+
+    PricingKernel::Columns columns;
+    columns.count = clients.size();
+    columns.offers.reserve(columns.count);
+    columns.discounts.reserve(columns.count);
+    columns.quantities.fill(0, qsizetype(supplementCount) * columns.count);
+    for (int i = 0; i < columns.count; ++i) {
+        const InlineClient &client = clients.at(i);
+        columns.offers.append(client.offer);
+        columns.discounts.append(client.discount);
+
+        int held = qMin(int(client.supplements.size()), supplementCount);
+        for (int suppId = 0; suppId < held; ++suppId) {
+            columns.quantities[qsizetype(suppId) * columns.count + i] = client.supplements.at(suppId);
+        }
+    }
+    return columns;
+}
+
+template <typename Function>
+static double bestOf(Function function, QList<int> *prices)
+{
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int run = 0; run < Repeats; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        *prices = function();
+        best = qMin(best, timer.nsecsElapsed());
+    }
+    return best / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QList<int> counts;
+    const QStringList arguments = app.arguments().mid(1);
+    for (const QString &argument : arguments) {
+        bool ok = false;
+        int count = argument.toInt(&ok);
+        if (!ok || count <= 0) {
+            out << "Invalid client count: " << argument << Qt::endl;
+            return 2;
+        }
+        counts.append(count);
+    }
+    if (counts.isEmpty()) {
+        counts = {10000, 100000, 1000000};
+    }
+
+    out << "Best of " << Repeats << " runs, milliseconds" << Qt::endl;
+    out << qSetFieldWidth(10) << "clients" << qSetFieldWidth(14) << "map rows" << "inline rows"
+        << "kernel" << "kernel only" << qSetFieldWidth(0) << Qt::endl;
+
+    bool agreed = true;
+    for (int count : std::as_const(counts)) {
+        Dataset dataset = generate(count);
+
+        QList<int> mapPrices;
+        QList<int> inlinePrices;
+        QList<int> kernelPrices;
+        QList<int> kernelOnlyPrices;
+
+        double mapTime = bestOf([&dataset]() {
+            return priceMapRows(dataset.table, dataset.mapClients);
+        }, &mapPrices);
+        double inlineTime = bestOf([&dataset]() {
+            return priceInlineRows(dataset.table, dataset.inlineClients);
+        }, &inlinePrices);
+        double kernelTime = bestOf([&dataset]() {
+            return PricingKernel::price(dataset.table, buildColumns(dataset.table, dataset.inlineClients));
+        }, &kernelPrices);
+
+        PricingKernel::Columns columns = buildColumns(dataset.table, dataset.inlineClients);
+        double kernelOnlyTime = bestOf([&dataset, &columns]() {
+            return PricingKernel::price(dataset.table, columns);
+        }, &kernelOnlyPrices);
+
+        out << qSetFieldWidth(10) << count << qSetFieldWidth(14) << qSetRealNumberPrecision(3) << Qt::fixed
+            << mapTime << inlineTime << kernelTime << kernelOnlyTime << qSetFieldWidth(0) << Qt::endl;
+
+        if (mapPrices != inlinePrices || mapPrices != kernelPrices || mapPrices != kernelOnlyPrices) {
+            out << "  prices differ between methods at " << count << " clients" << Qt::endl;
+            agreed = false;
+        }
+    }
+
+    return agreed ? 0 : 1;
+}
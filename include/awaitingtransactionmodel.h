@@ -13,7 +13,8 @@ public:
     enum Roles {
         DescriptionRole = Qt::UserRole + 1,
         AmountRole,
-        DateRole
+        DateRole,
+        DayRole
     };
     Q_ENUM(Roles)
 
@@ -28,8 +29,13 @@ public:
 
     // QAbstractListModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int entryCount() const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant entryData(int entry, int role) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {DescriptionRole, AmountRole, DateRole}; }
+    bool filterKey(int row, int role, qint64 *key) const override;
+    qint64 filterKeyFromValue(int role, const QVariant &value) const override;
 
     // AwaitingTransaction-specific methods
     Q_INVOKABLE void addAwaitingTransaction(const QString &description, double amount, const QString &date);
@@ -44,6 +50,7 @@ protected:
     void removeEntryFromModel(int index) override;
     void clearModel() override;
     void performSort() override;
+    int filterRoleForSortColumn(int column) const override;
 
 signals:
     void transactionApproved(const QString &description, double amount, const QString &date);
@@ -51,10 +58,15 @@ signals:
 private:
     struct AwaitingTransaction {
         QString description;
-        double amount;
-        QString date;
+        qint64 amount; // in cents
+        qint64 day; // Julian day number, 0 when unset
+        QString unparsedDate; // original text when it is not a date
+        QString sortKey;
     };
 
+    bool lessThan(const AwaitingTransaction &a, const AwaitingTransaction &b) const;
+    void updateSortKey(AwaitingTransaction &transaction) const;
+
     QList<AwaitingTransaction> m_awaitingTransactions;
 };
 
@@ -10,7 +10,14 @@
 #include <QFile>
 #include <QSettings>
 #include <QTimer>
+#include <QMap>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
 #include <QtQml/qqmlregistration.h>
+#include <algorithm>
+#include <functional>
+#include "binarystore.h"
 
 class DataManager;
 class RemoteDatabaseManager;
@@ -22,6 +29,8 @@ class BaseModel : public QAbstractListModel
     Q_PROPERTY(int count READ count NOTIFY countChanged)
     Q_PROPERTY(int sortColumn READ sortColumn NOTIFY sortColumnChanged)
     Q_PROPERTY(bool sortAscending READ sortAscending NOTIFY sortAscendingChanged)
+    Q_PROPERTY(int saveDelay READ saveDelay WRITE setSaveDelay NOTIFY saveDelayChanged)
+    Q_PROPERTY(bool saving READ saving NOTIFY savingChanged)
 
     friend class DataManager;
 
@@ -30,19 +39,61 @@ public:
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
+    // Paged models expose the first rows to views and load the rest through
+    // fetchMore; entryCount and entryData always cover every entry
+    virtual int entryCount() const { return rowCount(); }
+    virtual QVariant entryData(int entry, int role) const { return data(index(entry, 0), role); }
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    Q_INVOKABLE void fetchAll();
+
     Q_INVOKABLE void removeEntry(int index);
     Q_INVOKABLE void loadFromFile(bool remote);
     Q_INVOKABLE void clear();
     Q_INVOKABLE virtual void sortBy(int column);
+    Q_INVOKABLE void flush();
+
+    // Summary of every segment of a partitioned collection, oldest key first.
+    // Untouched segments are read from the manifest, edited ones recomputed.
+    Q_INVOKABLE QVariantList partitionSummaries() const;
 
-    int count() const { return rowCount(); }
+    int count() const { return entryCount(); }
     int sortColumn() const { return m_sortColumn; }
     bool sortAscending() const { return m_sortAscending; }
+    int saveDelay() const { return m_saveTimer->interval(); }
+    void setSaveDelay(int delay);
+    bool saving() const { return m_pendingWrites > 0; }
+
+    static QThreadPool *storageThreadPool();
+    static bool isBinaryStorageEnabled();
+
+    // Ledger values are kept as integer cents and Julian day numbers, QML and JSON see dollars and "yyyy-MM-dd".
+    // Text that is no date at all comes back in unparsed, so the row can keep it and save it unchanged.
+    static qint64 toCents(double amount) { return qRound64(amount * 100.0); }
+    static double fromCents(qint64 cents) { return cents / 100.0; }
+    static qint64 dayFromString(const QString &date, QString *unparsed = nullptr);
+    static QString dayToString(qint64 day, const QString &unparsed = QString());
+
+    // Text the filter proxy indexes for a row: one line per searchable role
+    virtual QList<int> searchRoles() const { return {}; }
+    virtual QString searchText(int row) const;
+
+    // Structured filters compare integer keys: amounts in cents, dates as day numbers,
+    // enums and counts as stored. filterKey returns false for roles without such a key.
+    virtual bool filterKey(int row, int role, qint64 *key) const;
+    virtual qint64 filterKeyFromValue(int role, const QVariant &value) const;
+
+    // Role whose filter keys follow the row order (ascending or descending as
+    // sortAscending says), or -1 when the rows are not ordered by such a key
+    int sortedFilterRole() const;
 
 signals:
     void countChanged();
     void sortColumnChanged();
     void sortAscendingChanged();
+    void saveDelayChanged();
+    void savingChanged();
+    void saveCompleted(bool success);
 
 protected:
     virtual QJsonObject entryToJson(int index) const = 0;
@@ -51,12 +102,148 @@ protected:
     virtual void removeEntryFromModel(int index) = 0;
     virtual void clearModel() = 0;
     virtual void performSort() = 0;
+    virtual int filterRoleForSortColumn(int column) const { Q_UNUSED(column) return -1; }
 
     void saveToFile();
+    // Sorts again right away, for edits that changed the sort key of many rows at once
+    void resort();
+    void recordInsert(int index);
+    void recordUpdate(const QJsonObject &before, int index);
+    void recordRemove(const QJsonObject &before);
+    void recordClear();
     void loadFromLocal();
     void loadFromRemote();
-    void saveToLocal(const QJsonArray &array);
+    void saveToLocal(const QJsonArray &array, quint16 snapshotFlags = 0);
     QString getDataFilePath() const;
+    QString getBinaryFilePath() const;
+    QString getJournalFilePath() const;
+    QString getPartitionDirPath() const;
+    QString getManifestFilePath() const;
+
+    // Paging, off unless a model sets a page size. Views see the first
+    // fetchedCount() entries of the sorted list.
+    void setPageSize(int pageSize);
+    bool isPaged() const { return m_pageSize > 0; }
+    int fetchedCount() const { return isPaged() ? m_fetchedRows : entryCount(); }
+    bool isFullyFetched() const { return !isPaged() || m_fetchedRows >= entryCount(); }
+
+    // Models that can read rows straight from mapped binary snapshots
+    virtual bool supportsMappedSnapshot() const { return false; }
+    bool isSnapshotMapped() const { return !m_mappedSegments.isEmpty(); }
+    int mappedRecordCount() const { return m_mappedCount; }
+    QJsonValue mappedRecord(int index) const;
+    void releaseSnapshot();
+
+    // Partitioned collections keep one segment file per key plus a manifest
+    // summarizing them; a save only rewrites the segments that changed.
+    virtual bool isPartitioned() const { return false; }
+    virtual QString partitionKey(const QJsonObject &entry) const { Q_UNUSED(entry) return QString(); }
+    virtual QString entryPartition(int index) const { return partitionKey(entryToJson(index)); }
+    // Extra manifest fields for a segment, next to its key and count
+    virtual QJsonObject partitionSummary(const QList<int> &indexes) const { Q_UNUSED(indexes) return QJsonObject(); }
+    // True while segments concatenated in key order are in the sorted row order
+    virtual bool partitionsFollowSort() const { return false; }
+    // Rows [begin, end) of a key, for models whose current sort keeps each key's rows together
+    virtual bool partitionSpan(const QString &key, int *begin, int *end) const
+    {
+        Q_UNUSED(key) Q_UNUSED(begin) Q_UNUSED(end)
+        return false;
+    }
+
+    // Sorted edits, lessThan compares two rows by the current sort column in ascending order.
+    // Text columns compare a case-folded copy that updateSortKey caches in each row.
+    template <typename Model, typename T>
+    using LessThan = bool (Model::*)(const T &, const T &) const;
+
+    template <typename Model, typename T>
+    auto sortedBefore(LessThan<Model, T> lessThan) const
+    {
+        const Model *model = static_cast<const Model *>(this);
+        bool ascending = m_sortAscending;
+        return [model, lessThan, ascending](const T &a, const T &b) {
+            return ascending ? (model->*lessThan)(a, b) : (model->*lessThan)(b, a);
+        };
+    }
+
+    template <typename Model, typename T>
+    void sortRows(QList<T> &list, LessThan<Model, T> lessThan, void (Model::*updateSortKey)(T &) const)
+    {
+        // Keys only depend on the column, flipping the direction reuses them
+        if (m_sortKeyColumn != m_sortColumn) {
+            const Model *model = static_cast<const Model *>(this);
+            for (T &row : list) {
+                (model->*updateSortKey)(row);
+            }
+            m_sortKeyColumn = m_sortColumn;
+        }
+
+        std::stable_sort(list.begin(), list.end(), sortedBefore(lessThan));
+    }
+
+    template <typename Model, typename T>
+    int insertSorted(QList<T> &list, const T &item, LessThan<Model, T> lessThan)
+    {
+        // Equal keys go after the existing rows, where stable_sort would put them
+        auto before = sortedBefore(lessThan);
+        int row = std::upper_bound(list.begin(), list.end(), item, before) - list.begin();
+
+        // Past the fetched rows the entry shows up once a view fetches that far
+        if (!isFullyFetched() && row >= m_fetchedRows) {
+            list.insert(row, item);
+            return row;
+        }
+
+        beginInsertRows(QModelIndex(), row, row);
+        list.insert(row, item);
+        endInsertRows();
+        return row;
+    }
+
+    template <typename Model, typename T>
+    int updateSorted(QList<T> &list, int row, const T &item, LessThan<Model, T> lessThan)
+    {
+        auto before = sortedBefore(lessThan);
+        list[row] = item;
+
+        int newRow = row;
+        if (row > 0 && before(item, list.at(row - 1))) {
+            newRow = std::upper_bound(list.begin(), list.begin() + row, item, before) - list.begin();
+        } else if (row + 1 < list.size() && before(list.at(row + 1), item)) {
+            newRow = std::upper_bound(list.begin() + row + 1, list.end(), item, before) - list.begin() - 1;
+        }
+
+        if (!isFullyFetched()) {
+            // Moving across the end of the fetched rows hides or reveals the entry
+            bool wasVisible = row < m_fetchedRows;
+            bool isVisible = newRow < m_fetchedRows;
+            if (wasVisible && !isVisible) {
+                beginRemoveRows(QModelIndex(), row, row);
+                list.move(row, newRow);
+                endRemoveRows();
+                return newRow;
+            }
+            if (!wasVisible) {
+                if (isVisible) {
+                    beginInsertRows(QModelIndex(), newRow, newRow);
+                    list.move(row, newRow);
+                    endInsertRows();
+                } else {
+                    list.move(row, newRow);
+                }
+                return newRow;
+            }
+        }
+
+        if (newRow != row) {
+            beginMoveRows(QModelIndex(), row, row, QModelIndex(), newRow > row ? newRow + 1 : newRow);
+            list.move(row, newRow);
+            endMoveRows();
+        }
+
+        QModelIndex changed = index(newRow, 0);
+        emit dataChanged(changed, changed);
+        return newRow;
+    }
 
     int m_sortColumn;
     bool m_sortAscending;
@@ -67,9 +254,44 @@ private slots:
 
 private:
     void ensureRemoteConnection();
+    void writeToStorage();
+    void runStorageTask(const std::function<bool()> &task, bool fullSaveOnFailure = false);
+    bool isJournalEnabled() const;
+    void appendToJournal(const QJsonObject &record);
+    QList<QJsonObject> readJournal(const QByteArray &snapshotData);
+    // segmentCheckpoints: per partition key, the checkpoints whose records its segment already holds
+    int replayJournal(QJsonArray &array, const QList<QJsonObject> &records,
+                      const QHash<QString, int> *segmentCheckpoints = nullptr);
+    bool hasJournalRecords() const;
+    bool mapSegments(const QStringList &filePaths);
+    quint16 sortFlags() const;
+    void scheduleWrite();
+    void loadPartitions();
+    void saveToPartitions(quint16 snapshotFlags);
+    void markPartitionDirty(const QJsonObject &entry);
+    QMap<QString, QList<int>> partitionRows(const QSet<QString> &keys, bool all) const;
+    QJsonObject summarizePartition(const QString &key, const QList<int> &indexes) const;
+
+    struct MappedSegment {
+        QSharedPointer<QFile> file;
+        BinaryStore store;
+        int first;
+    };
+
     QString m_fileName;
     bool m_isLoading;
     QTimer *m_sortTimer;
+    QTimer *m_saveTimer;
+    int m_pendingWrites;
+    qint64 m_journalSize;
+    int m_sortKeyColumn;
+    int m_pageSize;
+    int m_fetchedRows;
+    QList<MappedSegment> m_mappedSegments;
+    int m_mappedCount;
+    QMap<QString, QJsonObject> m_partitionSummaries;
+    QSet<QString> m_dirtyPartitions;
+    bool m_allPartitionsDirty;
 };
 
 #endif // BASEMODEL_H
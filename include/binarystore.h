@@ -0,0 +1,64 @@
+#ifndef BINARYSTORE_H
+#define BINARYSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QString>
+
+// Compact, versioned on-disk form of a model snapshot.
+//
+// Layout (little endian):
+//   header      "GTAB", version, flags, string count, record count,
+//               string index offset, record index offset
+//   strings     UTF-8 bytes of every interned key and string value
+//   records     varint length + tagged value, one per model entry
+//   indexes     string offsets (count + 1) and record offsets
+//
+// Whole numbers are stored as zigzag varints, amounts with two decimals as
+// integer cents and "yyyy-MM-dd" strings as days since the Unix epoch, so a
+// record only costs a few bytes per field. Both indexes allow random access
+// to a single record without decoding the rest of the file.
+//
+// The flags tell whether the records were written in a known sort order, so
+// a reader may serve them in place without sorting them again.
+class BinaryStore
+{
+public:
+    static const quint16 FormatVersion = 1;
+
+    enum Flag : quint16 {
+        SortColumnMask = 0x00ff,
+        AscendingFlag = 0x4000,
+        SortedFlag = 0x8000
+    };
+
+    static bool isBinary(const QByteArray &data);
+    static QByteArray encode(const QJsonArray &array, quint16 flags = 0);
+    static bool decode(const QByteArray &data, QJsonArray *array);
+
+    BinaryStore(const uchar *data = nullptr, qint64 size = 0);
+
+    bool isValid() const { return m_valid; }
+    quint16 flags() const { return m_flags; }
+    int recordCount() const { return m_recordCount; }
+    QJsonValue record(int index, bool *ok = nullptr) const;
+    QString string(quint32 index) const;
+
+private:
+    QJsonValue readValue(const uchar *&pos, const uchar *end, int depth, bool *ok) const;
+    QString key(quint32 index) const;
+
+    const uchar *m_data;
+    qint64 m_size;
+    bool m_valid;
+    quint16 m_flags;
+    quint32 m_stringCount;
+    quint32 m_recordCount;
+    const uchar *m_stringIndex;
+    const uchar *m_recordIndex;
+    mutable QHash<quint32, QString> m_keyCache;
+};
+
+#endif // BINARYSTORE_H
@@ -3,6 +3,9 @@
 #include "basemodel.h"
 #include "offermodel.h"
 #include "supplementmodel.h"
+#include "pricingkernel.h"
+#include <QSet>
+#include <QVarLengthArray>
 #include <QtQml/qqmlregistration.h>
 
 class ClientModel : public BaseModel
@@ -52,6 +55,10 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {NameRole, PhoneNumberRole, CommentRole, PriceRole, BusinessTypeRole}; }
+    QString searchText(int row) const override;
+    bool filterKey(int row, int role, qint64 *key) const override;
+    qint64 filterKeyFromValue(int role, const QVariant &value) const override;
     Q_INVOKABLE void addClient(int businessType, const QString &name, int offer, int price,
                                const QList<int> &supplements, int discount, const QString &phoneNumber, const QString &paymentDate,
                                const QString &comment);
@@ -72,6 +79,9 @@ public:
     Q_INVOKABLE void setOfferModel(OfferModel *model);
     Q_INVOKABLE void setSupplementModel(SupplementModel *model);
     Q_INVOKABLE void recalculateAllPrices();
+    // Only the clients using a supplement or offer in the given id range are repriced
+    Q_INVOKABLE void recalculateSupplementPrices(int firstId, int lastId);
+    Q_INVOKABLE void recalculateOfferPrices(int firstId, int lastId);
     Q_INVOKABLE void updateComment(int row, const QString &comment);
 
 protected:
@@ -81,25 +91,51 @@ protected:
     void removeEntryFromModel(int index) override;
     void clearModel() override;
     void performSort() override;
+    int filterRoleForSortColumn(int column) const override;
 
 signals:
     void checkoutCompleted(const QString &description, double amount);
 
 private:
+    // Quantity per supplement id (a SupplementModel row), 0 when not taken.
+    // Inline for the usual handful of supplements, no allocation per client.
+    using SupplementQuantities = QVarLengthArray<quint16, 16>;
+
     struct Client {
         BusinessType businessType;
         QString name;
         Offer offer;
         int price;
-        QMap<int, int> supplements;
+        SupplementQuantities supplements;
         int discount;
         QString phoneNumber;
         QString paymentDate;
         QString comment;
+        QString sortKey;
+        quint32 id; // runtime handle for the price index, not persisted
     };
+    bool lessThan(const Client &a, const Client &b) const;
+    void updateSortKey(Client &client) const;
+    static void setSupplementQuantity(SupplementQuantities &quantities, int suppId, int quantity);
+    static QVariantMap supplementMap(const SupplementQuantities &quantities);
+    int priceFor(const Client &client) const;
+    PricingKernel::PriceTable priceTable() const;
+    void recalculatePrices(const QSet<quint32> &clientIds);
+    void indexClient(const Client &client, bool add);
+    void ensurePriceIndex();
+    int rowOfClient(quint32 id) const;
+
     QList<Client> m_clients;
 
     OfferModel *m_offerModel;
     SupplementModel *m_supplementModel;
+
+    // Reverse index from supplement id and offer tier to the clients using them
+    quint32 m_nextClientId;
+    QHash<int, QSet<quint32>> m_clientsBySupplement;
+    QHash<int, QSet<quint32>> m_clientsByOffer;
+    bool m_priceIndexValid;
+    mutable QHash<quint32, int> m_clientRows;
+    mutable bool m_clientRowsValid;
 };
 #endif // CLIENTMODEL_H
@@ -9,7 +9,7 @@ class CompanySummaryModel : public BaseModel
     Q_OBJECT
     QML_ELEMENT
 
-    Q_PROPERTY(int money READ money NOTIFY moneyChanged)  // READ-ONLY
+    Q_PROPERTY(double money READ money NOTIFY moneyChanged)  // READ-ONLY
     Q_PROPERTY(QString companyName READ companyName WRITE setCompanyName NOTIFY companyNameChanged)
 
 public:
@@ -21,13 +21,13 @@ public:
     QHash<int, QByteArray> roleNames() const override;
 
     // Company summary properties
-    int money() const;
+    double money() const;
     QString companyName() const;
     void setCompanyName(const QString &name);
 
     // Money manipulation (only for internal use by transactions)
-    Q_INVOKABLE void addToMoney(int amount);
-    Q_INVOKABLE void subtractFromMoney(int amount);
+    Q_INVOKABLE void addToMoney(double amount);
+    Q_INVOKABLE void subtractFromMoney(double amount);
 
 signals:
     void moneyChanged();
@@ -42,9 +42,9 @@ protected:
     void performSort() override;
 
 private:
-    void setMoney(int money);  // Private setter
+    void setMoney(qint64 money);  // Private setter
 
-    int m_money;
+    qint64 m_money; // in cents, the same unit as the ledger
     QString m_companyName;
 };
 
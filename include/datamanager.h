@@ -34,7 +34,8 @@ public:
     static DataManager* create(QQmlEngine* qmlEngine, QJSEngine* jsEngine);
     static DataManager* instance();
 
-    Q_INVOKABLE bool exportData(const QString &filePath,
+    // The file is written on the storage thread, exportCompleted reports the outcome
+    Q_INVOKABLE void exportData(const QString &filePath,
                                 EmployeeModel *employeeModel,
                                 TransactionModel *transactionModel,
                                 AwaitingTransactionModel *awaitingTransactionModel,
@@ -33,6 +33,9 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {NameRole, PhoneRole, RoleRole, SalaryRole, AddedDateRole, CommentRole}; }
+    bool filterKey(int row, int role, qint64 *key) const override;
+    qint64 filterKeyFromValue(int role, const QVariant &value) const override;
     Q_INVOKABLE void addEmployee(const QString &name, const QString &phone,
                                  const QString &role, int salary, const QString &addedDate, const QString &comment);
     Q_INVOKABLE void updateEmployee(int index, const QString &name, const QString &phone,
@@ -46,6 +49,7 @@ protected:
     void removeEntryFromModel(int index) override;
     void clearModel() override;
     void performSort() override;
+    int filterRoleForSortColumn(int column) const override;
 
 signals:
     void paymentCompleted(const QString &description, double amount);
@@ -58,8 +62,12 @@ private:
         int salary;
         QString addedDate;
         QString comment;
+        QString sortKey;
     };
 
+    bool lessThan(const Employee &a, const Employee &b) const;
+    void updateSortKey(Employee &employee) const;
+
     QList<Employee> m_employees;
 };
 
@@ -2,7 +2,12 @@
 #define FILTERPROXYMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QAtomicInt>
 #include <QtQml/qqmlregistration.h>
+#include "searchindex.h"
+#include "basemodel.h"
 
 class FilterProxyModel : public QSortFilterProxyModel
 {
@@ -11,25 +16,80 @@ class FilterProxyModel : public QSortFilterProxyModel
 
     Q_PROPERTY(QString filterText READ filterText WRITE setFilterText NOTIFY filterTextChanged)
     Q_PROPERTY(QAbstractItemModel* sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+    Q_PROPERTY(bool searching READ searching NOTIFY searchingChanged)
 
 public:
     explicit FilterProxyModel(QObject *parent = nullptr);
+    ~FilterProxyModel();
 
     QString filterText() const;
     void setFilterText(const QString &text);
 
+    bool searching() const { return m_searching; }
+
     Q_INVOKABLE void setSourceModel(QAbstractItemModel *model) override;
 
+    // Typed filters on a role of the source model, combined with the text filter.
+    // Bounds are inclusive and given as QML sees the role (dollars, "yyyy-MM-dd"),
+    // an undefined or null bound leaves that side open.
+    Q_INVOKABLE void setRangeFilter(const QString &roleName, const QVariant &minimum, const QVariant &maximum);
+    Q_INVOKABLE void setValueFilter(const QString &roleName, const QVariant &value);
+    Q_INVOKABLE void removeColumnFilter(const QString &roleName);
+    Q_INVOKABLE void clearColumnFilters();
+
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
 
 signals:
     void filterTextChanged();
     void sourceModelChanged();
+    void searchingChanged();
+    void columnFiltersChanged();
 
 private:
+    struct SearchResult {
+        QString text;
+        QList<quint32> matches;   // sorted ids of the rows that matched
+        quint32 searchedUpTo = 0; // rows indexed after the search are tested directly
+    };
+
+    struct ColumnFilterSpec {
+        QVariant minimum;
+        QVariant maximum;
+    };
+
+    struct ColumnFilter {
+        int role;
+        qint64 minimum;
+        qint64 maximum;
+    };
+
+    void updateMatches();
+    void resetMatches();
+    void fetchAllWhileFiltering();
+    void publish(const SearchResult &result);
+    void setSearching(bool searching);
+    void compileColumnFilters();
+    bool acceptsColumns(int sourceRow) const;
+    void updateWindow() const;
+
     QString m_filterText;
-    bool matchesFilter(const QString &text) const;
+    QString m_foldedFilter;
+    QString m_appliedText;         // folded text the accepted rows currently reflect
+    QPointer<SearchIndex> m_index;
+    QList<SearchResult> m_results; // each entry refines the one before it, the last is applied
+    QSharedPointer<QAtomicInt> m_generation; // bumped to cancel the running search
+    bool m_searching;
+
+    QMap<QString, ColumnFilterSpec> m_columnFilterSpecs;
+    QList<ColumnFilter> m_columnFilters; // specs resolved against the source model's roles
+    QPointer<BaseModel> m_baseModel;
+
+    // Rows a range filter on the sorted role can match, found by binary search
+    mutable bool m_windowValid;
+    mutable int m_windowFilter;
+    mutable int m_windowFirst;
+    mutable int m_windowLast;
 };
 
 #endif // FILTERPROXYMODEL_H
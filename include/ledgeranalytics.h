@@ -0,0 +1,70 @@
+#ifndef LEDGERANALYTICS_H
+#define LEDGERANALYTICS_H
+
+#include "transactionmodel.h"
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QVariant>
+#include <QtQml/qqmlregistration.h>
+
+// Weekly and monthly totals plus the latest transaction of a TransactionModel,
+// kept up to date from its per-row signals instead of rescanning the ledger.
+class LedgerAnalytics : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(TransactionModel *transactionModel READ transactionModel WRITE setTransactionModel NOTIFY transactionModelChanged)
+    Q_PROPERTY(int weekCount READ weekCount WRITE setWeekCount NOTIFY weekCountChanged)
+    Q_PROPERTY(int monthCount READ monthCount WRITE setMonthCount NOTIFY monthCountChanged)
+    Q_PROPERTY(QVariantList weeklyTotals READ weeklyTotals NOTIFY totalsChanged)
+    Q_PROPERTY(QVariantList monthlyTotals READ monthlyTotals NOTIFY totalsChanged)
+    Q_PROPERTY(QVariant lastTransaction READ lastTransaction NOTIFY lastTransactionChanged)
+
+public:
+    explicit LedgerAnalytics(QObject *parent = nullptr);
+
+    TransactionModel *transactionModel() const { return m_model; }
+    void setTransactionModel(TransactionModel *model);
+
+    int weekCount() const { return m_weekCount; }
+    void setWeekCount(int count);
+    int monthCount() const { return m_monthCount; }
+    void setMonthCount(int count);
+
+    QVariantList weeklyTotals() const;
+    QVariantList monthlyTotals() const;
+    QVariant lastTransaction() const;
+
+signals:
+    void transactionModelChanged();
+    void weekCountChanged();
+    void monthCountChanged();
+    void totalsChanged();
+    void lastTransactionChanged();
+
+private slots:
+    void rebuild();
+    void onTransactionInserted(const QString &description, double amount, qint64 day);
+    void onTransactionRemoved(const QString &description, double amount, qint64 day);
+
+private:
+    struct Latest {
+        QString description;
+        qint64 amount = 0; // in cents
+        qint64 day = 0;
+    };
+
+    void addToBuckets(qint64 cents, qint64 day);
+    void findLatest();
+
+    QPointer<TransactionModel> m_model;
+    int m_weekCount;
+    int m_monthCount;
+    QHash<qint64, qint64> m_weeks;  // Monday's Julian day -> cents
+    QHash<int, qint64> m_months;    // year * 12 + month - 1 -> cents
+    Latest m_latest;
+};
+
+#endif // LEDGERANALYTICS_H
@@ -0,0 +1,41 @@
+#ifndef LEDGERINDEX_H
+#define LEDGERINDEX_H
+
+#include <QList>
+#include <QMap>
+#include <QtGlobal>
+
+// Fenwick tree of amounts (in cents) keyed by Julian day number.
+//
+// Covers a contiguous window of days that grows on demand; entries without a
+// date (day 0) are kept apart and count as older than any dated entry. Point
+// updates and prefix sums are O(log d) where d is the number of days covered.
+// The window is bounded, days far outside it (a mistyped year) are summed from
+// a sparse map instead, and the window moves if most days end up there.
+class LedgerIndex
+{
+public:
+    LedgerIndex();
+
+    void clear();
+    void add(qint64 day, qint64 cents);
+
+    qint64 total() const { return m_total; }
+    qint64 sumThrough(qint64 day) const;
+    qint64 sumBetween(qint64 firstDay, qint64 lastDay) const;
+
+private:
+    bool cover(qint64 day);
+    void relocate();
+    void build(qint64 firstDay, const QList<qint64> &values);
+
+    qint64 m_firstDay;
+    qint64 m_undated;
+    qint64 m_total;
+    QList<qint64> m_values; // per day, used to rebuild the tree when the window grows
+    QList<qint64> m_tree;   // 1-based Fenwick tree over m_values
+    QMap<qint64, qint64> m_outliers; // days the window could not reach
+    int m_outlierLimit;
+};
+
+#endif // LEDGERINDEX_H
@@ -28,6 +28,7 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {NameRole, PriceRole}; }
 
     // Offer-specific methods
     Q_INVOKABLE void addOffer(const QString &name, int price);
@@ -36,7 +37,8 @@ public:
     Q_INVOKABLE int getOfferPrice(int index) const;
 
 signals:
-    void priceDataChanged();
+    // Ids are rows, so a price edit that re-sorts the list renumbers every row it passed
+    void priceDataChanged(int firstId, int lastId);
 
 protected:
     QJsonObject entryToJson(int index) const override;
@@ -50,8 +52,12 @@ private:
     struct Offer {
         QString name;
         int price; // in cents
+        QString sortKey;
     };
 
+    bool lessThan(const Offer &a, const Offer &b) const;
+    void updateSortKey(Offer &offer) const;
+
     QList<Offer> m_offers;
 };
 
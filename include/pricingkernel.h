@@ -0,0 +1,36 @@
+#ifndef PRICINGKERNEL_H
+#define PRICINGKERNEL_H
+
+#include <QList>
+#include <QtGlobal>
+
+// Batch client pricing over column arrays.
+//
+// A client's price is (offer price + sum of supplement price * quantity)
+// * (100 - discount) / 100, in integer dollars. Clients are laid out as
+// columns and supplement quantities column-major, so each supplement adds
+// to a contiguous run of totals the compiler can vectorize.
+class PricingKernel
+{
+public:
+    // Prices snapshotted from the offer and supplement models, indexed by id
+    struct PriceTable {
+        QList<int> offerPrices;
+        QList<int> supplementPrices;
+    };
+
+    struct Columns {
+        int count = 0;
+        QList<int> offers;
+        QList<int> discounts;
+        QList<quint16> quantities; // quantities[supplement * count + client]
+    };
+
+    // Large batches are split across the global thread pool
+    static QList<int> price(const PriceTable &table, const Columns &columns);
+
+private:
+    static void priceRange(const PriceTable &table, const Columns &columns, int first, int last, int *prices);
+};
+
+#endif // PRICINGKERNEL_H
@@ -7,6 +7,7 @@
 #include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QHash>
 #include <QtQml/qqmlregistration.h>
 
 class RemoteDatabaseManager : public QObject
@@ -39,6 +40,20 @@ private:
     QString getApiUrl(const QString &endpoint) const;
     void makeRequest(const QString &method, const QString &endpoint, const QJsonObject &data = QJsonObject());
 
+    // Last load of each collection, sent back as If-None-Match so an unchanged
+    // collection is answered with an empty 304
+    struct CachedLoad {
+        QByteArray etag;
+        QByteArray payload;
+    };
+
+    QHash<QString, CachedLoad> m_loadCache;
+    QString loadCacheKey(const QString &collection) const;
+    QString loadCacheFilePath(const QString &key) const;
+    CachedLoad cachedLoad(const QString &key);
+    void storeCachedLoad(const QString &key, const CachedLoad &cached);
+    void dropCachedLoad(const QString &key);
+
     static RemoteDatabaseManager* m_instance;
 };
 
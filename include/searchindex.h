@@ -0,0 +1,83 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <functional>
+
+// Trigram index over the searchable text of every row of a list model.
+//
+// Each row gets an id that stays stable while rows are inserted, removed or
+// moved around it; a changed row is re-indexed under a fresh id. Ids only grow,
+// so posting lists stay sorted by appending and can be intersected linearly.
+// Texts are stored case-folded, searches expect a case-folded needle.
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    using TextProvider = std::function<QString(int row)>;
+    using CancelCheck = std::function<bool()>;
+
+    // Implicitly shared copy of the index, safe to search from another thread
+    // while the model keeps changing the original.
+    struct Snapshot {
+        QHash<quint32, QString> texts;
+        QHash<quint64, QList<quint32>> postings;
+        quint32 nextId = 0;
+    };
+
+    // Must be created before anything else connects to the model, so the index
+    // is already up to date when those connections see a change.
+    SearchIndex(QAbstractItemModel *model, const TextProvider &textProvider, QObject *parent = nullptr);
+
+    int rowCount() const { return m_rowIds.size(); }
+    quint32 rowId(int row) const { return m_rowIds.value(row); }
+    QString text(quint32 id) const { return m_texts.value(id); }
+    quint32 nextId() const { return m_nextId; }
+    Snapshot snapshot() const { return {m_texts, m_postings, m_nextId}; }
+
+    // Sorted ids of the rows whose text contains needle
+    QList<quint32> search(const QString &needle) const { return search(snapshot(), needle); }
+
+    // Same, restricted to a previous result: the sorted candidates plus any row
+    // indexed from id since onwards. Used when the needle got longer.
+    QList<quint32> refine(const QString &needle, const QList<quint32> &candidates, quint32 since) const
+    {
+        return refine(snapshot(), needle, candidates, since);
+    }
+
+    // Work on a snapshot is done in chunks; once cancelled returns true the
+    // search stops early and its partial result must be ignored.
+    static QList<quint32> search(const Snapshot &data, const QString &needle, const CancelCheck &cancelled = {});
+    static QList<quint32> refine(const Snapshot &data, const QString &needle, const QList<quint32> &candidates,
+                                 quint32 since, const CancelCheck &cancelled = {});
+
+signals:
+    void rebuilt();
+    // Any change to the model's rows, after the index caught up with it
+    void updated();
+
+private slots:
+    void rebuild();
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onRowsRemoved(const QModelIndex &parent, int first, int last);
+    void onRowsMoved(const QModelIndex &parent, int first, int last, const QModelIndex &destination, int row);
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+private:
+    quint32 addText(const QString &folded);
+    void removeText(quint32 id);
+
+    QAbstractItemModel *m_model;
+    TextProvider m_textProvider;
+    QList<quint32> m_rowIds;
+    QHash<quint32, QString> m_texts;
+    QHash<quint64, QList<quint32>> m_postings;
+    quint32 m_nextId;
+};
+
+#endif // SEARCHINDEX_H
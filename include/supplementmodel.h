@@ -28,6 +28,7 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {NameRole, PriceRole}; }
 
     // Supplement-specific methods
     Q_INVOKABLE void addSupplement(const QString &name, int price);
@@ -36,7 +37,8 @@ public:
     Q_INVOKABLE int getSupplementPrice(int index) const;
 
 signals:
-    void priceDataChanged();
+    // Ids are rows, so a price edit that re-sorts the list renumbers every row it passed
+    void priceDataChanged(int firstId, int lastId);
 
 protected:
     QJsonObject entryToJson(int index) const override;
@@ -50,8 +52,12 @@ private:
     struct Supplement {
         QString name;
         int price; // in cents
+        QString sortKey;
     };
 
+    bool lessThan(const Supplement &a, const Supplement &b) const;
+    void updateSortKey(Supplement &supplement) const;
+
     QList<Supplement> m_supplements;
 };
 
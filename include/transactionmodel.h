@@ -2,6 +2,7 @@
 #define TRANSACTIONMODEL_H
 
 #include "basemodel.h"
+#include "ledgerindex.h"
 #include <QtQml/qqmlregistration.h>
 
 class TransactionModel : public BaseModel
@@ -13,7 +14,8 @@ public:
     enum Roles {
         DescriptionRole = Qt::UserRole + 1,
         AmountRole,
-        DateRole
+        DateRole,
+        DayRole
     };
     Q_ENUM(Roles)
 
@@ -28,8 +30,13 @@ public:
 
     // QAbstractListModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int entryCount() const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant entryData(int entry, int role) const override;
     QHash<int, QByteArray> roleNames() const override;
+    QList<int> searchRoles() const override { return {DescriptionRole, AmountRole, DateRole}; }
+    bool filterKey(int row, int role, qint64 *key) const override;
+    qint64 filterKeyFromValue(int role, const QVariant &value) const override;
 
     // Transaction-specific methods
     Q_INVOKABLE void addTransaction(const QString &description, double amount, const QString &date);
@@ -37,6 +44,21 @@ public:
     Q_INVOKABLE void addTransactionFromCheckout(const QString &description, double amount);
     Q_INVOKABLE double getTransactionAmount(int index) const;
 
+    // Balance queries, O(log d) over the days covered by the ledger
+    Q_INVOKABLE double ledgerBalance() const;
+    Q_INVOKABLE double balanceAt(const QString &date) const;
+    Q_INVOKABLE double totalBetween(const QString &firstDate, const QString &lastDate) const;
+    Q_INVOKABLE QVariantList balanceHistory(const QString &firstDate, const QString &lastDate, int stepDays = 1) const;
+
+signals:
+    // A new entry entered the ledger; unlike rowsInserted not emitted for rows paged in by fetchMore
+    void transactionAdded(const QString &description, double amount);
+
+    // Emitted for every single-row edit, an update is a removal followed by an insertion.
+    // Resets (loading, clearing, importing) only emit modelReset.
+    void transactionInserted(const QString &description, double amount, qint64 day);
+    void transactionRemoved(const QString &description, double amount, qint64 day);
+
 protected:
     QJsonObject entryToJson(int index) const override;
     void entryFromJson(const QJsonObject &obj) override;
@@ -44,15 +66,48 @@ protected:
     void removeEntryFromModel(int index) override;
     void clearModel() override;
     void performSort() override;
+    int filterRoleForSortColumn(int column) const override;
+    bool supportsMappedSnapshot() const override { return true; }
+
+    // One segment per month, keyed "yyyy-MM"
+    bool isPartitioned() const override { return true; }
+    QString partitionKey(const QJsonObject &entry) const override;
+    QString entryPartition(int index) const override;
+    QJsonObject partitionSummary(const QList<int> &indexes) const override;
+    bool partitionsFollowSort() const override { return m_sortColumn == SortByDate; }
+    bool partitionSpan(const QString &key, int *begin, int *end) const override;
 
 private:
     struct Transaction {
         QString description;
-        double amount;
-        QString date;
+        qint64 amount; // in cents
+        qint64 day; // Julian day number, 0 when unset
+        QString unparsedDate; // original text when it is not a date
+        QString sortKey;
     };
 
+    // Mapped rows decoded lately, slot row % size; a delegate asks for several roles of the same row
+    struct CachedRow {
+        int row = -1;
+        Transaction transaction;
+    };
+
+    static Transaction transactionFromJson(const QJsonObject &obj);
+    QString monthOf(qint64 day) const;
+    qint64 dayAt(int index) const;
+    bool lessThan(const Transaction &a, const Transaction &b) const;
+    void updateSortKey(Transaction &transaction) const;
+    Transaction transactionAt(int index) const;
+    void materialize();
+    void clearRowCache();
+    const LedgerIndex &ledgerIndex() const;
+
     QList<Transaction> m_transactions;
+    mutable QList<CachedRow> m_rowCache;
+    // Partition keys by year * 12 + month - 1, formatted once per month
+    mutable QHash<int, QString> m_monthKeys;
+    mutable LedgerIndex m_ledgerIndex;
+    mutable bool m_ledgerIndexValid;
 };
 
 #endif // TRANSACTIONMODEL_H
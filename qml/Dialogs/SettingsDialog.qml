@@ -90,6 +90,21 @@ Dialog {
             }
         }
 
+        RowLayout {
+            Layout.fillWidth: true
+
+            Label {
+                text: "Compact local storage"
+                Layout.fillWidth: true
+                font.bold: true
+            }
+
+            Switch {
+                checked: UserSettings.useBinaryStorage
+                onClicked: UserSettings.useBinaryStorage = checked
+            }
+        }
+
         MenuSeparator {
             Layout.fillWidth: true
         }
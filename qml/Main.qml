@@ -18,6 +18,9 @@ ApplicationWindow {
     Material.accent: Constants.accentColor
     color: Constants.surfaceColor
 
+    // Sorting and imports reset the ledger too, only the first local load is checked
+    property bool balanceVerified: false
+
     Component.onCompleted: {
         RemoteDatabaseManager
 
@@ -170,27 +173,44 @@ ApplicationWindow {
 
     Connections {
         target: transactionModel
-        function onRowsInserted(parent, first, last) {
-            for (var i = first; i <= last; i++) {
-                var amount = transactionModel.getTransactionAmount(i)
-                companySummaryModel.addToMoney(amount)
+        function onTransactionAdded(description, amount) {
+            companySummaryModel.addToMoney(amount)
+        }
+        function onModelReset() {
+            if (!window.balanceVerified) {
+                Qt.callLater(window.verifyBalance)
             }
         }
     }
 
+    // The stored balance is the starting money set by hand plus the ledger, both are loaded by then
+    function verifyBalance() {
+        if (balanceVerified || UserSettings.useRemoteDatabase) {
+            return
+        }
+        balanceVerified = true
+
+        var ledgerBalance = transactionModel.ledgerBalance()
+        var openingBalance = companySummaryModel.money - ledgerBalance
+        if (openingBalance <= -0.005) {
+            console.warn("Company balance", companySummaryModel.money, "is below the ledger total", ledgerBalance,
+                         "- opening balance", openingBalance)
+        } else {
+            console.log("Opening balance", openingBalance, "- ledger total", ledgerBalance)
+        }
+    }
+
     Connections {
         target: supplementModel
-        function onPriceDataChanged() {
-            console.log("pass")
-            clientModel.recalculateAllPrices()
+        function onPriceDataChanged(firstId, lastId) {
+            clientModel.recalculateSupplementPrices(firstId, lastId)
         }
     }
 
     Connections {
         target: offerModel
-        function onPriceDataChanged() {
-            console.log("pass")
-            clientModel.recalculateAllPrices()
+        function onPriceDataChanged(firstId, lastId) {
+            clientModel.recalculateOfferPrices(firstId, lastId)
         }
     }
 
@@ -402,6 +422,10 @@ ApplicationWindow {
     Connections {
         target: DataManager
         function onExportCompleted(success, message) {
+            // The dialog closed before the write ran, bring it back under the error to pick another location
+            if (!success) {
+                exportDialog.open()
+            }
             messageDialog.show(success, message)
         }
         function onImportCompleted(success, message) {
@@ -175,6 +175,16 @@ Page {
                 width: 180
                 placeholderText: "Filter..."
                 onTextChanged: AppState.filterText = text
+
+                BusyIndicator {
+                    anchors.right: parent.right
+                    anchors.rightMargin: 8
+                    anchors.verticalCenter: parent.verticalCenter
+                    width: 16
+                    height: 16
+                    running: visible
+                    visible: AppState.transactionFilterModel ? AppState.transactionFilterModel.searching : false
+                }
             }
 
             Item {
@@ -5,6 +5,7 @@ import QtCore
 Settings {
     property bool firstRun: true
     property bool darkMode: true
+    property bool useBinaryStorage: false
 
     property bool useRemoteDatabase: false
     property string remoteHost: "localhost"
@@ -58,107 +58,14 @@ Column {
         }
     }
 
-    function getMonday(date) {
-        var d = new Date(date)
-        var day = d.getDay()
-        var diff = d.getDate() - day + (day === 0 ? -6 : 1)
-        d.setDate(diff)
-        d.setHours(0, 0, 0, 0)
-        return d
+    LedgerAnalytics {
+        id: ledgerAnalytics
+        transactionModel: AppState.transactionModel
+        onTotalsChanged: root.updateWeeklyChart()
     }
 
-    function getWeekKey(date) {
-        var monday = getMonday(date)
-        return monday.toISOString().split('T')[0]
-    }
-
-    function formatWeekLabel(dateStr) {
-        var date = new Date(dateStr)
-        var monthNames = ["Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"]
-        return monthNames[date.getMonth()] + " " + date.getDate()
-    }
-
-    function getLastTransaction() {
-        if (!AppState.transactionModel || AppState.transactionModel.count === 0) {
-            return null
-        }
-
-        var latestDate = null
-        var latestIndex = -1
-
-        for (var i = AppState.transactionModel.count - 1; i >= 0; i--) {
-            var index = AppState.transactionModel.index(i, 0)
-            var dateStr = AppState.transactionModel.data(index, TransactionModel.DateRole)
-
-            if (!dateStr) continue
-
-            var date = new Date(dateStr)
-
-            if (!latestDate || date > latestDate) {
-                latestDate = date
-                latestIndex = i
-            }
-        }
-
-        if (latestIndex === -1) return null
-
-        var idx = AppState.transactionModel.index(latestIndex, 0)
-        return {
-            description: AppState.transactionModel.data(idx, TransactionModel.DescriptionRole),
-            amount: AppState.transactionModel.data(idx, TransactionModel.AmountRole),
-            date: AppState.transactionModel.data(idx, TransactionModel.DateRole)
-        }
-    }
-
-    function scanTransactions() {
-        if (!AppState.transactionModel) return
-
-        var weeks = {}
-        var oldestDate = new Date()
-        var hasData = false
-
-        for (var i = 0; i < AppState.transactionModel.count; i++) {
-            var index = AppState.transactionModel.index(i, 0)
-            var dateStr = AppState.transactionModel.data(index, TransactionModel.DateRole)
-            var amount = AppState.transactionModel.data(index, TransactionModel.AmountRole)
-
-            if (!dateStr || amount === undefined) continue
-
-            hasData = true
-            var date = new Date(dateStr)
-            if (date < oldestDate) {
-                oldestDate = date
-            }
-
-            var weekKey = getWeekKey(date)
-
-            if (!weeks[weekKey]) {
-                weeks[weekKey] = {
-                    monday: weekKey,
-                    total: 0
-                }
-            }
-
-            weeks[weekKey].total += amount
-        }
-
-        var endDate = getMonday(new Date())
-        var startDate = new Date(endDate)
-        startDate.setDate(startDate.getDate() - (11 * 7))
-
-        var weeksArray = []
-        for (var j = 0; j < 12; j++) {
-            var weekDate = new Date(startDate)
-            weekDate.setDate(weekDate.getDate() + (j * 7))
-            var key = getWeekKey(weekDate)
-
-            weeksArray.push({
-                                monday: key,
-                                total: weeks[key] ? weeks[key].total : 0
-                            })
-        }
-
+    function updateWeeklyChart() {
+        var weeksArray = ledgerAnalytics.weeklyTotals
         root.weeklyTotals = weeksArray
 
         var maxAbs = 0
@@ -171,7 +78,7 @@ Column {
         weeksDisplayModel.clear()
         for (var m = 0; m < weeksArray.length; m++) {
             weeksDisplayModel.append({
-                                         weekLabel: root.formatWeekLabel(weeksArray[m].monday),
+                                         weekLabel: weeksArray[m].label,
                                          weekTotal: weeksArray[m].total
                                      })
         }
@@ -187,7 +94,7 @@ Column {
         clientRepeater.model = AppState.clientModel
         employeeRepeater.model = AppState.employeeModel
 
-        scanTransactions()
+        updateWeeklyChart()
 
         Qt.callLater(function() {
             root.weeklyRevenue = root.weeklyIncome - root.weeklyOutcome
@@ -687,19 +594,7 @@ Column {
                         }
                     }
 
-                    property var lastTransaction: null
-
-                    Component.onCompleted: {
-                        lastTransaction = root.getLastTransaction()
-                    }
-
-                    Connections {
-                        target: AppState.transactionModel
-                        function onCountChanged() { lastActivityCard.lastTransaction = root.getLastTransaction() }
-                        function onRowsInserted() { lastActivityCard.lastTransaction = root.getLastTransaction() }
-                        function onRowsRemoved() { lastActivityCard.lastTransaction = root.getLastTransaction() }
-                        function onDataChanged() { lastActivityCard.lastTransaction = root.getLastTransaction() }
-                    }
+                    property var lastTransaction: ledgerAnalytics.lastTransaction
 
                     ColumnLayout {
                         anchors.fill: parent
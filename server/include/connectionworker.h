@@ -0,0 +1,56 @@
+#ifndef CONNECTIONWORKER_H
+#define CONNECTIONWORKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include "httprequestparser.h"
+
+class DatabaseServer;
+
+// Accepts connections without creating their sockets, so each socket can be
+// created in the worker thread that serves it.
+class ConnectionListener : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    using QTcpServer::QTcpServer;
+
+signals:
+    void connectionAvailable(qintptr socketDescriptor);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override { emit connectionAvailable(socketDescriptor); }
+};
+
+// Serves the connections handed to one thread: frames their requests, has the
+// server answer them and writes the responses back in request order.
+class ConnectionWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConnectionWorker(DatabaseServer *server);
+
+public slots:
+    void addConnection(qintptr socketDescriptor);
+    void closeAll();
+
+private slots:
+    void readyRead();
+    void clientDisconnected();
+
+private:
+    struct Connection {
+        HttpRequestParser parser;
+        QTimer *idleTimer = nullptr;
+    };
+
+    DatabaseServer *m_server;
+    QHash<QTcpSocket *, Connection> m_connections;
+};
+
+#endif // CONNECTIONWORKER_H
@@ -13,45 +13,97 @@
 #include <QDateTime>
 #include <QRegularExpression>
 #include "usermanager.h"
+#include "httprequestparser.h"
+#include "connectionworker.h"
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
 
+// Requests are answered on worker threads, each serving its own connections.
+// Everything reachable from handleHttpRequest must be safe to call from all of
+// them at once: collections are guarded by a lock each, users and the data
+// directory are only set up before start().
+//
+// Collections are kept in memory as serialized JSON. Loads send those bytes,
+// saves replace them and are written behind to disk; stop() writes the rest.
 class DatabaseServer : public QObject
 {
     Q_OBJECT
 
+    friend class ConnectionWorker;
+
 public:
+    // Idle persistent connections are closed after this long
+    static const int IdleTimeout = 30000;
+
     explicit DatabaseServer(QObject *parent = nullptr);
     ~DatabaseServer();
 
     bool start(quint16 port = 3000);
-    void stop();
+    // False when saves still in memory could not be written to disk
+    bool stop();
     void setDataDirectory(const QString &path);
+    // Takes effect on the next start(), defaults to the number of cores
+    void setThreadCount(int count);
+    int threadCount() const { return m_threadCount; }
 
 private slots:
-    void newConnection();
-    void readyRead();
-    void clientDisconnected();
+    void newConnection(qintptr socketDescriptor);
 
 private:
-    QTcpServer *m_server;
+    ConnectionListener *m_server;
     QString m_dataDirectory;
     QTimer *m_logTimer;
     UserManager *m_userManager;
+    int m_threadCount;
+    int m_nextWorker;
+    QList<QThread *> m_threads;
+    QList<ConnectionWorker *> m_workers;
+
+    struct Collection {
+        QReadWriteLock lock;
+        bool loaded = false;
+        QByteArray json;
+        int count = 0;
+        QByteArray hash; // SHA-1 of json, hex
+        quint64 revision = 0;
+        quint64 writtenRevision = 0;
+        bool flushFailed = false; // the last write to disk did not go through
+    };
+
+    struct CollectionSnapshot {
+        QByteArray json;
+        int count;
+        QByteArray hash;
+    };
+
+    QMutex m_collectionsMutex;
+    QHash<QString, QSharedPointer<Collection>> m_collections;
+    QTimer *m_flushTimer;
+    QThreadPool m_flushPool;
 
     bool authenticateRequest(const QString &username, const QString &password);
     bool isRequestReadOnly(const QString &username);
     void logRequest(const QString &method, const QString &path, const QString &response = "");
 
-    QJsonObject loadCollection(const QString &collection);
+    CollectionSnapshot loadCollection(const QString &collection);
     bool saveCollection(const QString &collection, const QJsonArray &data);
     QString getCollectionPath(const QString &collection);
+    QSharedPointer<Collection> collectionEntry(const QString &filePath);
+    bool scheduleFlush();
+    bool flushCollections();
+    static QString collectionETag(const CollectionSnapshot &snapshot, const QString &username, bool readonly);
+    static bool etagMatches(const QString &ifNoneMatch, const QString &etag);
 
     // HTTP handling
-    void handleHttpRequest(QTcpSocket *socket, const QString &request);
-    QByteArray createHttpResponse(int statusCode, const QString &body, const QString &contentType = "application/json");
-    QString parseHttpMethod(const QString &request);
-    QString parseHttpPath(const QString &request);
-    QString parseHttpBody(const QString &request);
-    QString getHttpHeader(const QString &request, const QString &headerName);
+    // Returns the response and whether the connection stays open for further requests
+    QByteArray handleHttpRequest(const HttpRequestParser::Request &request, bool *keepAlive);
+    QByteArray createHttpResponse(int statusCode, const QByteArray &body, bool keepAlive = false,
+                                  const QString &etag = QString(), const QString &contentType = "application/json");
 };
 
 #endif // DATABASESERVER_H
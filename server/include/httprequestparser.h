@@ -0,0 +1,66 @@
+#ifndef HTTPREQUESTPARSER_H
+#define HTTPREQUESTPARSER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// Incremental parser for the HTTP/1.1 requests read from one connection.
+//
+// Bytes are fed as they arrive. The request line and headers are parsed once,
+// when the blank line ending them is in, then the body is collected until
+// Content-Length bytes have been read. Bytes past the end of a request stay
+// buffered for the next one.
+class HttpRequestParser
+{
+public:
+    enum Status {
+        Incomplete,
+        Complete,
+        Failed
+    };
+
+    struct Request {
+        QString method;
+        QString path;
+        QString version;
+        QHash<QString, QString> headers; // names lower-cased
+        QByteArray body;
+
+        QString header(const QString &name) const { return headers.value(name.toLower()); }
+    };
+
+    HttpRequestParser();
+
+    // Appends data and parses as far as it allows
+    Status feed(const QByteArray &data);
+
+    // Valid once feed returned Complete, parsing restarts on the buffered bytes
+    Request takeRequest();
+
+    // Set once feed returned Failed, the connection cannot be recovered
+    int errorStatus() const { return m_errorStatus; }
+    QString errorString() const { return m_errorString; }
+
+private:
+    enum State {
+        ReadingHead,
+        ReadingBody,
+        Done,
+        Error
+    };
+
+    Status parse();
+    bool parseHead(const QByteArray &head);
+    Status fail(int status, const QString &message);
+
+    State m_state;
+    QByteArray m_buffer;
+    qsizetype m_scanned;
+    qint64 m_contentLength;
+    Request m_request;
+    int m_errorStatus;
+    QString m_errorString;
+};
+
+#endif // HTTPREQUESTPARSER_H
@@ -0,0 +1,96 @@
+#include "connectionworker.h"
+#include "databaseserver.h"
+#include <QDebug>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+ConnectionWorker::ConnectionWorker(DatabaseServer *server)
+    : QObject(nullptr)
+    , m_server(server)
+{
+}
+
+void ConnectionWorker::addConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *tcpSocket = new QTcpSocket(this);
+    if (!tcpSocket->setSocketDescriptor(socketDescriptor)) {
+        qWarning() << "Failed to accept connection:" << tcpSocket->errorString();
+        delete tcpSocket;
+        return;
+    }
+
+    // Connections stay open between requests until they sit idle for too long
+    QTimer *idleTimer = new QTimer(tcpSocket);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(DatabaseServer::IdleTimeout);
+    connect(idleTimer, &QTimer::timeout, tcpSocket, [tcpSocket]() {
+        qDebug() << "Closing idle connection from:" << tcpSocket->peerAddress().toString();
+        tcpSocket->disconnectFromHost();
+    });
+    idleTimer->start();
+
+    Connection connection;
+    connection.idleTimer = idleTimer;
+    m_connections.insert(tcpSocket, connection);
+
+    // HTTP mode only - nginx handles HTTPS
+    connect(tcpSocket, &QTcpSocket::readyRead, this, &ConnectionWorker::readyRead);
+    connect(tcpSocket, &QTcpSocket::disconnected, this, &ConnectionWorker::clientDisconnected);
+    qDebug() << "New HTTP connection from:" << tcpSocket->peerAddress().toString();
+}
+
+void ConnectionWorker::closeAll()
+{
+    const QList<QTcpSocket *> sockets = m_connections.keys();
+    for (QTcpSocket *socket : sockets) {
+        socket->disconnect(this);
+        socket->flush();
+        socket->disconnectFromHost();
+        delete socket;
+    }
+    m_connections.clear();
+}
+
+void ConnectionWorker::readyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) return;
+
+    HttpRequestParser &parser = it->parser;
+    it->idleTimer->start();
+
+    // A request may span many reads, it is only handled once its whole body is in.
+    // Pipelined requests already buffered are answered in order.
+    HttpRequestParser::Status status = parser.feed(socket->readAll());
+    while (status == HttpRequestParser::Complete) {
+        bool keepAlive = false;
+        socket->write(m_server->handleHttpRequest(parser.takeRequest(), &keepAlive));
+        if (!keepAlive) {
+            // Closing may disconnect right away and drop the connection's state
+            socket->close();
+            return;
+        }
+        status = parser.feed(QByteArray());
+    }
+
+    if (status == HttpRequestParser::Failed) {
+        QJsonObject error;
+        error["error"] = parser.errorString();
+        socket->write(m_server->createHttpResponse(parser.errorStatus(), QJsonDocument(error).toJson()));
+        m_server->logRequest("-", "-", QString("MALFORMED REQUEST: %1").arg(parser.errorString()));
+        socket->close();
+    }
+}
+
+void ConnectionWorker::clientDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket) {
+        m_connections.remove(socket);
+        socket->deleteLater();
+    }
+}
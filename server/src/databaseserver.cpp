@@ -6,14 +6,32 @@
 #include <QJsonParseError>
 #include <QHostAddress>
 #include <QTextStream>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+// Longest time a save stays in memory only
+static const int WriteBehindDelay = 2000;
 
 DatabaseServer::DatabaseServer(QObject *parent)
     : QObject(parent)
-    , m_server(new QTcpServer(this))
+    , m_server(new ConnectionListener(this))
     , m_userManager(new UserManager(this))
+    , m_threadCount(qMax(1, QThread::idealThreadCount()))
+    , m_nextWorker(0)
+    , m_flushTimer(new QTimer(this))
 {
     m_dataDirectory = "";
-    connect(m_server, &QTcpServer::newConnection, this, &DatabaseServer::newConnection);
+    connect(m_server, &ConnectionListener::connectionAvailable, this, &DatabaseServer::newConnection);
+
+    // Saves reach the disk on their own thread, in the order they were flushed
+    m_flushPool.setMaxThreadCount(1);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(WriteBehindDelay);
+    connect(m_flushTimer, &QTimer::timeout, this, [this]() {
+        m_flushPool.start([this]() { flushCollections(); });
+    });
 
     m_logTimer = new QTimer(this);
     connect(m_logTimer, &QTimer::timeout, this, [this]() {
@@ -29,7 +47,20 @@ DatabaseServer::~DatabaseServer()
 bool DatabaseServer::start(quint16 port)
 {
     if (m_server->listen(QHostAddress::Any, port)) {
+        // Every worker thread runs its own event loop and owns the sockets handed to it
+        for (int i = 0; i < m_threadCount; ++i) {
+            QThread *thread = new QThread(this);
+            ConnectionWorker *worker = new ConnectionWorker(this);
+            worker->moveToThread(thread);
+            connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+            thread->start();
+
+            m_threads.append(thread);
+            m_workers.append(worker);
+        }
+
         qDebug() << "GTACOMPTA Database Server started on port" << port;
+        qDebug() << "Worker threads:" << m_threadCount;
         qDebug() << "Data directory:" << m_dataDirectory;
         qDebug() << "Running in HTTP mode (nginx handles HTTPS)";
         qDebug() << "User authentication enabled";
@@ -42,13 +73,42 @@ bool DatabaseServer::start(quint16 port)
     return false;
 }
 
-void DatabaseServer::stop()
+bool DatabaseServer::stop()
 {
+    bool flushed = true;
     if (m_server->isListening()) {
         m_server->close();
         m_logTimer->stop();
+
+        for (ConnectionWorker *worker : std::as_const(m_workers)) {
+            QMetaObject::invokeMethod(worker, &ConnectionWorker::closeAll, Qt::BlockingQueuedConnection);
+        }
+        for (QThread *thread : std::as_const(m_threads)) {
+            thread->quit();
+            thread->wait();
+        }
+        qDeleteAll(m_threads);
+        m_threads.clear();
+        m_workers.clear();
+
+        // No more saves can come in, whatever is still in memory goes to disk now
+        m_flushTimer->stop();
+        m_flushPool.waitForDone();
+        flushed = flushCollections();
+        if (flushed) {
+            qDebug() << "All collections written to disk";
+        } else {
+            qWarning() << "Some collections could not be written to disk - their last saves are lost";
+        }
+
         qDebug() << "Server stopped";
     }
+    return flushed;
+}
+
+void DatabaseServer::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
 }
 
 void DatabaseServer::setDataDirectory(const QString &path)
@@ -59,45 +119,28 @@ void DatabaseServer::setDataDirectory(const QString &path)
     qDebug() << "Data directory set to:" << m_dataDirectory;
 }
 
-void DatabaseServer::newConnection()
+void DatabaseServer::newConnection(qintptr socketDescriptor)
 {
-    while (m_server->hasPendingConnections()) {
-        QTcpSocket *tcpSocket = m_server->nextPendingConnection();
+    // Round-robin, the socket is created in the worker's own thread
+    ConnectionWorker *worker = m_workers.at(m_nextWorker);
+    m_nextWorker = (m_nextWorker + 1) % m_workers.size();
 
-        // HTTP mode only - nginx handles HTTPS
-        connect(tcpSocket, &QTcpSocket::readyRead, this, &DatabaseServer::readyRead);
-        connect(tcpSocket, &QTcpSocket::disconnected, this, &DatabaseServer::clientDisconnected);
-        qDebug() << "New HTTP connection from:" << tcpSocket->peerAddress().toString();
-    }
+    QMetaObject::invokeMethod(worker, [worker, socketDescriptor]() {
+        worker->addConnection(socketDescriptor);
+    }, Qt::QueuedConnection);
 }
 
-void DatabaseServer::readyRead()
+QByteArray DatabaseServer::handleHttpRequest(const HttpRequestParser::Request &request, bool *keepAliveResult)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) return;
-
-    QByteArray data = socket->readAll();
-    QString request = QString::fromUtf8(data);
-
-    handleHttpRequest(socket, request);
-}
+    // HTTP/1.1 keeps the connection unless told otherwise, HTTP/1.0 only when asked to
+    QString connectionHeader = request.header("Connection").toLower();
+    bool keepAlive = request.version == "HTTP/1.0" ? connectionHeader == "keep-alive" : connectionHeader != "close";
 
-void DatabaseServer::clientDisconnected()
-{
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (socket) {
-        socket->deleteLater();
-    }
-}
-
-void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &request)
-{
-    QString method = parseHttpMethod(request);
-    QString path = parseHttpPath(request);
-    QString body = parseHttpBody(request);
-    QString protocolVersion = getHttpHeader(request, "X-Protocol-Version");
-    QString username = getHttpHeader(request, "X-Username");
-    QString userPassword = getHttpHeader(request, "X-User-Password");
+    QString method = request.method;
+    QString path = request.path;
+    QString protocolVersion = request.header("X-Protocol-Version");
+    QString username = request.header("X-Username");
+    QString userPassword = request.header("X-User-Password");
 
     QByteArray response;
 
@@ -108,17 +151,16 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
         error["serverVersion"] = "1.0";
         error["clientVersion"] = protocolVersion;
         response = createHttpResponse(400, QJsonDocument(error).toJson());
-        socket->write(response);
-        socket->close();
         logRequest(method, path, "PROTOCOL VERSION MISMATCH");
-        return;
+        *keepAliveResult = false;
+        return response;
     }
 
     // User authentication check
     if (!authenticateRequest(username, userPassword)) {
         QJsonObject error;
         error["error"] = "Unauthorized - Invalid user credentials";
-        response = createHttpResponse(401, QJsonDocument(error).toJson());
+        response = createHttpResponse(401, QJsonDocument(error).toJson(), keepAlive);
         logRequest(method, path, "UNAUTHORIZED - USER");
     }
     // Test connection
@@ -133,7 +175,7 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
         result["username"] = username;
         result["readonly"] = isRequestReadOnly(username);
 
-        response = createHttpResponse(200, QJsonDocument(result).toJson());
+        response = createHttpResponse(200, QJsonDocument(result).toJson(), keepAlive);
         logRequest(method, path, QString("Connection test successful for user: %1").arg(username));
     }
     // Save data - check if user has write permissions
@@ -141,18 +183,18 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
         if (isRequestReadOnly(username)) {
             QJsonObject error;
             error["error"] = "Forbidden - Read-only user cannot save data";
-            response = createHttpResponse(403, QJsonDocument(error).toJson());
+            response = createHttpResponse(403, QJsonDocument(error).toJson(), keepAlive);
             logRequest(method, path, QString("FORBIDDEN - User %1 attempted to save").arg(username));
         } else {
             QString collection = path.mid(10);
 
             QJsonParseError error;
-            QJsonDocument doc = QJsonDocument::fromJson(body.toUtf8(), &error);
+            QJsonDocument doc = QJsonDocument::fromJson(request.body, &error);
 
             if (error.error != QJsonParseError::NoError) {
                 QJsonObject errorObj;
                 errorObj["error"] = "Invalid JSON";
-                response = createHttpResponse(400, QJsonDocument(errorObj).toJson());
+                response = createHttpResponse(400, QJsonDocument(errorObj).toJson(), keepAlive);
             } else {
                 QJsonObject requestData = doc.object();
                 QJsonArray data = requestData["data"].toArray();
@@ -165,7 +207,7 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
                     result["error"] = "Failed to save data";
                 }
 
-                response = createHttpResponse(200, QJsonDocument(result).toJson());
+                response = createHttpResponse(200, QJsonDocument(result).toJson(), keepAlive);
                 logRequest(method, path, QString("Save %1 by %2: %3").arg(collection).arg(username).arg(success ? "SUCCESS" : "FAILED"));
             }
         }
@@ -174,14 +216,26 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
     else if (method == "GET" && path.startsWith("/api/load/")) {
         QString collection = path.mid(10);
 
-        QJsonObject data = loadCollection(collection);
+        CollectionSnapshot snapshot = loadCollection(collection);
+        bool readonly = isRequestReadOnly(username);
+        QString etag = collectionETag(snapshot, username, readonly);
 
-        // Add readonly status to response
-        data["readonly"] = isRequestReadOnly(username);
-        data["username"] = username;
+        if (etagMatches(request.header("If-None-Match"), etag)) {
+            response = createHttpResponse(304, QByteArray(), keepAlive, etag);
+            logRequest(method, path, QString("Load %1 by %2: not modified").arg(collection).arg(username));
+        } else {
+            // Add readonly status to response
+            QJsonObject fields;
+            fields["readonly"] = readonly;
+            fields["username"] = username;
+
+            // The cached array is spliced in as is, only the per-user fields are serialized
+            QByteArray body = "{\"data\":" + snapshot.json + ","
+                              + QJsonDocument(fields).toJson(QJsonDocument::Compact).mid(1);
 
-        response = createHttpResponse(200, QJsonDocument(data).toJson());
-        logRequest(method, path, QString("Load %1 by %2: %3 items").arg(collection).arg(username).arg(data["data"].toArray().size()));
+            response = createHttpResponse(200, body, keepAlive, etag);
+            logRequest(method, path, QString("Load %1 by %2: %3 items").arg(collection).arg(username).arg(snapshot.count));
+        }
     }
     // Server status
     else if (method == "GET" && path == "/api/status") {
@@ -199,91 +253,87 @@ void DatabaseServer::handleHttpRequest(QTcpSocket *socket, const QString &reques
         QStringList jsonFiles = dataDir.entryList(QStringList() << "*.json", QDir::Files);
         status["collections"] = jsonFiles.size();
 
-        response = createHttpResponse(200, QJsonDocument(status).toJson());
+        response = createHttpResponse(200, QJsonDocument(status).toJson(), keepAlive);
         logRequest(method, path, QString("Status check by user: %1").arg(username));
     }
     // Not found
     else {
         QJsonObject error;
         error["error"] = "Not found";
-        response = createHttpResponse(404, QJsonDocument(error).toJson());
+        response = createHttpResponse(404, QJsonDocument(error).toJson(), keepAlive);
         logRequest(method, path, "NOT FOUND");
     }
 
-    socket->write(response);
-    socket->close();
+    *keepAliveResult = keepAlive;
+    return response;
+}
+
+QString DatabaseServer::collectionETag(const CollectionSnapshot &snapshot, const QString &username, bool readonly)
+{
+    // The body also carries the user's name and access, a different user must not match
+    QByteArray user = QCryptographicHash::hash((username + (readonly ? ":r" : ":w")).toUtf8(),
+                                               QCryptographicHash::Sha1).toHex().left(8);
+    return QString("\"%1-%2\"").arg(QString::fromLatin1(snapshot.hash), QString::fromLatin1(user));
+}
+
+bool DatabaseServer::etagMatches(const QString &ifNoneMatch, const QString &etag)
+{
+    // A list of validators, weak ones compare equal to their strong form
+    const QStringList candidates = ifNoneMatch.split(',', Qt::SkipEmptyParts);
+    for (QString candidate : candidates) {
+        candidate = candidate.trimmed();
+        if (candidate.startsWith("W/"))
+            candidate = candidate.mid(2);
+        if (candidate == "*" || candidate == etag)
+            return true;
+    }
+    return false;
 }
 
-QByteArray DatabaseServer::createHttpResponse(int statusCode, const QString &body, const QString &contentType)
+QByteArray DatabaseServer::createHttpResponse(int statusCode, const QByteArray &body, bool keepAlive, const QString &etag,
+                                              const QString &contentType)
 {
     QString statusText;
     switch (statusCode) {
     case 200: statusText = "OK"; break;
+    case 304: statusText = "Not Modified"; break;
     case 400: statusText = "Bad Request"; break;
     case 401: statusText = "Unauthorized"; break;
     case 403: statusText = "Forbidden"; break;
     case 404: statusText = "Not Found"; break;
+    case 413: statusText = "Payload Too Large"; break;
+    case 431: statusText = "Request Header Fields Too Large"; break;
     case 500: statusText = "Internal Server Error"; break;
+    case 501: statusText = "Not Implemented"; break;
+    case 505: statusText = "HTTP Version Not Supported"; break;
     default: statusText = "Unknown"; break;
     }
 
-    // Convert body to UTF-8 bytes
-    QByteArray bodyBytes = body.toUtf8();
-
     // Create header as string first
-    QString headerStr = QString("HTTP/1.1 %1 %2\r\n"
-                                "Content-Type: %3; charset=utf-8\r\n"
-                                "Content-Length: %4\r\n"
-                                "Connection: close\r\n"
-                                "\r\n")
-                            .arg(statusCode)
-                            .arg(statusText)
-                            .arg(contentType)
-                            .arg(bodyBytes.size());
-
-    // Convert header to bytes and combine
-    QByteArray headerBytes = headerStr.toUtf8();
-    return headerBytes + bodyBytes;
-}
-
-QString DatabaseServer::parseHttpMethod(const QString &request)
-{
-    QStringList lines = request.split("\r\n");
-    if (lines.isEmpty()) return "";
-
-    QStringList parts = lines.first().split(" ");
-    return parts.isEmpty() ? "" : parts.first();
-}
-
-QString DatabaseServer::parseHttpPath(const QString &request)
-{
-    QStringList lines = request.split("\r\n");
-    if (lines.isEmpty()) return "";
-
-    QStringList parts = lines.first().split(" ");
-    return parts.size() > 1 ? parts.at(1) : "";
-}
-
-QString DatabaseServer::parseHttpBody(const QString &request)
-{
-    int bodyStart = request.indexOf("\r\n\r\n");
-    if (bodyStart == -1) return "";
-
-    return request.mid(bodyStart + 4);
-}
-
-QString DatabaseServer::getHttpHeader(const QString &request, const QString &headerName)
-{
-    QStringList lines = request.split("\r\n");
-    QString headerPrefix = headerName.toLower() + ": ";
+    QString headerStr = QString("HTTP/1.1 %1 %2\r\n").arg(statusCode).arg(statusText);
+
+    // A 304 has no body, the client keeps the one it already has
+    if (statusCode != 304) {
+        headerStr += QString("Content-Type: %1; charset=utf-8\r\n"
+                             "Content-Length: %2\r\n")
+                         .arg(contentType)
+                         .arg(body.size());
+    }
 
-    for (const QString &line : lines) {
-        if (line.toLower().startsWith(headerPrefix)) {
-            return line.mid(line.indexOf(":") + 1).trimmed();
-        }
+    // Validated responses may be stored but are always checked with the server first
+    if (!etag.isEmpty()) {
+        headerStr += QString("ETag: %1\r\n"
+                             "Cache-Control: no-cache\r\n")
+                         .arg(etag);
     }
 
-    return "";
+    headerStr += keepAlive ? QString("Connection: keep-alive\r\nKeep-Alive: timeout=%1\r\n").arg(IdleTimeout / 1000)
+                           : QString("Connection: close\r\n");
+    headerStr += "\r\n";
+
+    // Convert header to bytes and combine
+    QByteArray headerBytes = headerStr.toUtf8();
+    return headerBytes + body;
 }
 
 bool DatabaseServer::authenticateRequest(const QString &username, const QString &password)
@@ -307,59 +357,148 @@ void DatabaseServer::logRequest(const QString &method, const QString &path, cons
              << (response.isEmpty() ? "" : "- " + response);
 }
 
-QJsonObject DatabaseServer::loadCollection(const QString &collection)
+QSharedPointer<DatabaseServer::Collection> DatabaseServer::collectionEntry(const QString &filePath)
 {
-    QJsonObject result;
-    QString filePath = getCollectionPath(collection);
+    QMutexLocker locker(&m_collectionsMutex);
 
-    QFile file(filePath);
-    if (!file.exists()) {
-        result["data"] = QJsonArray();
-        return result;
+    QSharedPointer<Collection> &entry = m_collections[filePath];
+    if (!entry) {
+        entry.reset(new Collection);
     }
+    return entry;
+}
 
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to open file for reading:" << filePath;
-        result["data"] = QJsonArray();
-        return result;
+DatabaseServer::CollectionSnapshot DatabaseServer::loadCollection(const QString &collection)
+{
+    QString filePath = getCollectionPath(collection);
+    QSharedPointer<Collection> entry = collectionEntry(filePath);
+
+    // Loads of one collection run side by side, only the first one reads the disk
+    {
+        QReadLocker locker(&entry->lock);
+        if (entry->loaded)
+            return {entry->json, entry->count, entry->hash};
     }
 
-    QByteArray jsonData = file.readAll();
-    file.close();
+    QWriteLocker locker(&entry->lock);
+    if (entry->loaded)
+        return {entry->json, entry->count, entry->hash};
 
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(jsonData, &error);
+    QJsonArray data;
+    QFile file(filePath);
+    if (file.exists()) {
+        if (file.open(QIODevice::ReadOnly)) {
+            QJsonParseError error;
+            QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+            file.close();
 
-    if (error.error != QJsonParseError::NoError) {
-        qWarning() << "JSON parse error for" << collection << ":" << error.errorString();
-        result["data"] = QJsonArray();
-        return result;
+            if (error.error == QJsonParseError::NoError) {
+                data = doc.array();
+            } else {
+                qWarning() << "JSON parse error for" << collection << ":" << error.errorString();
+            }
+        } else {
+            qWarning() << "Failed to open file for reading:" << filePath;
+        }
     }
 
-    result["data"] = doc.array();
-    return result;
+    entry->json = QJsonDocument(data).toJson(QJsonDocument::Compact);
+    entry->count = data.size();
+    entry->hash = QCryptographicHash::hash(entry->json, QCryptographicHash::Sha1).toHex();
+    entry->loaded = true;
+    return {entry->json, entry->count, entry->hash};
 }
 
 bool DatabaseServer::saveCollection(const QString &collection, const QJsonArray &data)
 {
     QString filePath = getCollectionPath(collection);
+    QSharedPointer<Collection> entry = collectionEntry(filePath);
+
+    // Serialized once here, every later load sends these bytes as they are
+    QByteArray json = QJsonDocument(data).toJson(QJsonDocument::Compact);
+    QByteArray hash = QCryptographicHash::hash(json, QCryptographicHash::Sha1).toHex();
+    bool flushFailed;
+    {
+        QWriteLocker locker(&entry->lock);
+        entry->json = json;
+        entry->count = data.size();
+        entry->hash = hash;
+        entry->loaded = true;
+        ++entry->revision;
+        flushFailed = entry->flushFailed;
+    }
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open file for writing:" << filePath;
+    // The data is kept and retried, but the client must not take it as stored
+    if (flushFailed) {
+        qWarning() << "Save of" << collection << "kept in memory, the previous write to disk failed";
         return false;
     }
+    return scheduleFlush();
+}
 
-    QJsonDocument doc(data);
-    qint64 bytesWritten = file.write(doc.toJson());
-    file.close();
+bool DatabaseServer::scheduleFlush()
+{
+    // Called from worker threads; the delay runs from the first unwritten save so it stays bounded
+    bool scheduled = QMetaObject::invokeMethod(m_flushTimer, [this]() {
+        if (!m_flushTimer->isActive())
+            m_flushTimer->start();
+    }, Qt::QueuedConnection);
+
+    if (!scheduled) {
+        qWarning() << "Could not schedule writing collections to disk";
+    }
+    return scheduled;
+}
 
-    if (bytesWritten == -1) {
-        qWarning() << "Failed to write data to file:" << filePath;
-        return false;
+bool DatabaseServer::flushCollections()
+{
+    QHash<QString, QSharedPointer<Collection>> collections;
+    {
+        QMutexLocker locker(&m_collectionsMutex);
+        collections = m_collections;
     }
 
-    return true;
+    bool success = true;
+    for (auto it = collections.cbegin(); it != collections.cend(); ++it) {
+        const QSharedPointer<Collection> &entry = it.value();
+
+        QByteArray json;
+        quint64 revision;
+        {
+            QReadLocker locker(&entry->lock);
+            if (entry->revision == entry->writtenRevision)
+                continue;
+            json = entry->json;
+            revision = entry->revision;
+        }
+
+        // Written outside the lock, saves and loads carry on meanwhile
+        QSaveFile file(it.key());
+        bool written = file.open(QIODevice::WriteOnly);
+        if (!written) {
+            qWarning() << "Failed to open file for writing:" << it.key();
+        } else {
+            file.write(json);
+            written = file.commit();
+            if (!written) {
+                qWarning() << "Failed to write data to file:" << it.key();
+            }
+        }
+
+        QWriteLocker locker(&entry->lock);
+        entry->flushFailed = !written;
+        if (!written) {
+            success = false;
+            continue;
+        }
+        entry->writtenRevision = qMax(entry->writtenRevision, revision);
+    }
+
+    if (!success) {
+        // Try again later rather than lose the saves
+        scheduleFlush();
+    }
+    return success;
 }
 
 QString DatabaseServer::getCollectionPath(const QString &collection)
@@ -0,0 +1,140 @@
+#include "httprequestparser.h"
+#include <QList>
+
+// Request line plus headers; anything longer is not a GTACOMPTA client
+static const qsizetype MaxHeadSize = 64 * 1024;
+
+// Whole-collection saves, the largest request a client sends
+static const qint64 MaxBodySize = 256 * 1024 * 1024;
+
+// The length is announced before anyone is authenticated, so only this much is allocated up front
+static const qint64 MaxBodyReserve = 16 * 1024 * 1024;
+
+HttpRequestParser::HttpRequestParser()
+    : m_state(ReadingHead)
+    , m_scanned(0)
+    , m_contentLength(0)
+    , m_errorStatus(0)
+{
+}
+
+HttpRequestParser::Status HttpRequestParser::feed(const QByteArray &data)
+{
+    if (m_state == Error)
+        return Failed;
+
+    m_buffer.append(data);
+    return parse();
+}
+
+HttpRequestParser::Request HttpRequestParser::takeRequest()
+{
+    Request request = m_request;
+
+    m_request = Request();
+    m_state = ReadingHead;
+    m_scanned = 0;
+    m_contentLength = 0;
+    return request;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse()
+{
+    if (m_state == Done)
+        return Complete;
+
+    if (m_state == ReadingHead) {
+        // Resume where the last search stopped, a separator may straddle two reads
+        qsizetype end = m_buffer.indexOf("\r\n\r\n", qMax<qsizetype>(0, m_scanned - 3));
+        if (end == -1) {
+            m_scanned = m_buffer.size();
+            if (m_buffer.size() > MaxHeadSize)
+                return fail(431, "Request Header Fields Too Large");
+            return Incomplete;
+        }
+
+        if (end > MaxHeadSize)
+            return fail(431, "Request Header Fields Too Large");
+
+        if (!parseHead(m_buffer.left(end)))
+            return Failed;
+
+        m_buffer.remove(0, end + 4);
+        m_request.body.reserve(qMin(m_contentLength, MaxBodyReserve));
+        m_state = ReadingBody;
+    }
+
+    // Body bytes move into the request as they arrive, the buffer only holds the latest read
+    qint64 missing = m_contentLength - m_request.body.size();
+    if (missing > 0 && !m_buffer.isEmpty()) {
+        qsizetype taken = qMin<qint64>(missing, m_buffer.size());
+        m_request.body.append(m_buffer.constData(), taken);
+        m_buffer.remove(0, taken);
+    }
+
+    if (m_request.body.size() < m_contentLength)
+        return Incomplete;
+
+    m_state = Done;
+    return Complete;
+}
+
+bool HttpRequestParser::parseHead(const QByteArray &head)
+{
+    QList<QByteArray> lines = head.split('\n');
+
+    QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+    if (requestLine.size() != 3 || requestLine.at(0).isEmpty() || !requestLine.at(1).startsWith('/')) {
+        fail(400, "Malformed request line");
+        return false;
+    }
+
+    m_request.method = QString::fromLatin1(requestLine.at(0));
+    m_request.path = QString::fromUtf8(requestLine.at(1));
+    m_request.version = QString::fromLatin1(requestLine.at(2));
+    if (!m_request.version.startsWith("HTTP/1.")) {
+        fail(505, "HTTP Version Not Supported");
+        return false;
+    }
+
+    for (const QByteArray &line : std::as_const(lines)) {
+        qsizetype colon = line.indexOf(':');
+        if (colon <= 0) {
+            fail(400, "Malformed header line");
+            return false;
+        }
+
+        QString name = QString::fromLatin1(line.left(colon).trimmed()).toLower();
+        m_request.headers.insert(name, QString::fromUtf8(line.mid(colon + 1).trimmed()));
+    }
+
+    // Clients always send a length; chunked uploads are not worth supporting
+    if (m_request.headers.contains("transfer-encoding")) {
+        fail(501, "Transfer-Encoding not supported");
+        return false;
+    }
+
+    bool ok = true;
+    QString contentLength = m_request.headers.value("content-length");
+    m_contentLength = contentLength.isEmpty() ? 0 : contentLength.toLongLong(&ok);
+    if (!ok || m_contentLength < 0) {
+        fail(400, "Invalid Content-Length");
+        return false;
+    }
+
+    if (m_contentLength > MaxBodySize) {
+        fail(413, "Payload Too Large");
+        return false;
+    }
+
+    return true;
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(int status, const QString &message)
+{
+    m_state = Error;
+    m_errorStatus = status;
+    m_errorString = message;
+    m_buffer.clear();
+    return Failed;
+}
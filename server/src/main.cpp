@@ -8,6 +8,42 @@
 #include "databaseserver.h"
 #include "usermanager.h"
 
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int signalSockets[2];
+
+static void handleTerminationSignal(int)
+{
+    // Only async-signal-safe calls here, the event loop reads the byte and quits
+    char byte = 1;
+    [[maybe_unused]] ssize_t written = ::write(signalSockets[0], &byte, sizeof(byte));
+}
+
+// Ctrl+C and SIGTERM quit through the event loop, so collections still in memory get written
+static void installTerminationHandlers(QCoreApplication *app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalSockets) != 0) {
+        qWarning() << "Could not install signal handlers, unsaved data is lost on Ctrl+C";
+        return;
+    }
+
+    QSocketNotifier *notifier = new QSocketNotifier(signalSockets[1], QSocketNotifier::Read, app);
+    QObject::connect(notifier, &QSocketNotifier::activated, app, [notifier]() {
+        notifier->setEnabled(false);
+        char byte;
+        [[maybe_unused]] ssize_t received = ::read(signalSockets[1], &byte, sizeof(byte));
+        QCoreApplication::quit();
+    });
+
+    std::signal(SIGINT, handleTerminationSignal);
+    std::signal(SIGTERM, handleTerminationSignal);
+}
+#endif
+
 void printWelcomeBanner()
 {
     QTextStream out(stdout);
@@ -20,12 +56,13 @@ void printWelcomeBanner()
     out << Qt::endl;
 }
 
-void printServerInfo(quint16 port, const QString &dataDir)
+void printServerInfo(quint16 port, const QString &dataDir, int threads)
 {
     QTextStream out(stdout);
     out << "Server Configuration:" << Qt::endl;
     out << "  Port: " << port << Qt::endl;
     out << "  Data Directory: " << dataDir << Qt::endl;
+    out << "  Worker Threads: " << threads << Qt::endl;
     out << Qt::endl;
     out << "API Endpoints:" << Qt::endl;
     out << "  GET  /api/test              - Test connection" << Qt::endl;
@@ -78,6 +115,9 @@ int main(int argc, char *argv[])
     QCommandLineOption dataOption(QStringList() << "d" << "data-dir",
                                   QString("Data directory path (default: %1)").arg(defaultDataDir),
                                   "path");
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads",
+                                     "Number of worker threads serving requests (default: number of CPU cores)",
+                                     "count");
     QCommandLineOption verboseOption(QStringList() << "verbose",
                                      "Enable verbose logging");
 
@@ -94,6 +134,7 @@ int main(int argc, char *argv[])
 
     parser.addOption(portOption);
     parser.addOption(dataOption);
+    parser.addOption(threadsOption);
     parser.addOption(verboseOption);
     parser.addOption(addUserOption);
     parser.addOption(deleteUserOption);
@@ -194,23 +235,43 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (parser.isSet(threadsOption)) {
+        bool threadsOk;
+        int threads = parser.value(threadsOption).toInt(&threadsOk);
+        if (!threadsOk || threads <= 0) {
+            qCritical() << "Invalid thread count:" << parser.value(threadsOption);
+            return 1;
+        }
+        server.setThreadCount(threads);
+    }
+
     if (!server.start(port)) {
         qCritical() << "Failed to start server on port" << port;
         return 1;
     }
 
-    printServerInfo(port, dataDir);
+    printServerInfo(port, dataDir, server.threadCount());
 
     // Show current users
     userManager.listUsers();
 
-    QObject::connect(&app, &QCoreApplication::aboutToQuit, [&server]() {
+#ifdef Q_OS_UNIX
+    installTerminationHandlers(&app);
+#endif
+
+    bool flushed = true;
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, [&server, &flushed]() {
         qDebug() << "Shutting down server...";
-        server.stop();
+        flushed = server.stop();
     });
 
     int result = app.exec();
 
+    // Saves that never reached the disk are gone, whatever runs the server should know
+    if (result == 0 && !flushed) {
+        result = 1;
+    }
+
     qDebug() << "Server shutdown complete";
     return result;
 }
@@ -1,32 +1,52 @@
 #include "awaitingtransactionmodel.h"
 #include <algorithm>
 
+// Rows handed to views per fetch, newest first
+static const int PageSize = 500;
+
 AwaitingTransactionModel::AwaitingTransactionModel(QObject *parent)
     : BaseModel("awaiting_transactions.json", parent)
 {
     m_sortColumn = SortByDate;
+    m_sortAscending = false;
+    setPageSize(PageSize);
 }
 
 int AwaitingTransactionModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
+    return fetchedCount();
+}
+
+int AwaitingTransactionModel::entryCount() const
+{
     return m_awaitingTransactions.size();
 }
 
 QVariant AwaitingTransactionModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= m_awaitingTransactions.size())
+    if (!index.isValid() || index.row() >= rowCount())
         return QVariant();
 
-    const AwaitingTransaction &transaction = m_awaitingTransactions.at(index.row());
+    return entryData(index.row(), role);
+}
+
+QVariant AwaitingTransactionModel::entryData(int entry, int role) const
+{
+    if (entry < 0 || entry >= m_awaitingTransactions.size())
+        return QVariant();
+
+    const AwaitingTransaction &transaction = m_awaitingTransactions.at(entry);
 
     switch (role) {
     case DescriptionRole:
         return transaction.description;
     case AmountRole:
-        return transaction.amount;
+        return fromCents(transaction.amount);
     case DateRole:
-        return transaction.date;
+        return dayToString(transaction.day, transaction.unparsedDate);
+    case DayRole:
+        return transaction.day;
     default:
         return QVariant();
     }
@@ -38,21 +58,51 @@ QHash<int, QByteArray> AwaitingTransactionModel::roleNames() const
     roles[DescriptionRole] = "description";
     roles[AmountRole] = "amount";
     roles[DateRole] = "date";
+    roles[DayRole] = "day";
     return roles;
 }
 
-void AwaitingTransactionModel::addAwaitingTransaction(const QString &description, double amount, const QString &date)
+bool AwaitingTransactionModel::filterKey(int row, int role, qint64 *key) const
 {
-    beginInsertRows(QModelIndex(), m_awaitingTransactions.size(), m_awaitingTransactions.size());
-    m_awaitingTransactions.append({description, amount, date});
-    endInsertRows();
+    if (row < 0 || row >= entryCount())
+        return false;
 
-    beginResetModel();
-    performSort();
-    endResetModel();
+    const AwaitingTransaction &transaction = m_awaitingTransactions.at(row);
+    switch (role) {
+    case AmountRole:
+        *key = transaction.amount;
+        return true;
+    case DateRole:
+    case DayRole:
+        *key = transaction.day;
+        return true;
+    default:
+        return false;
+    }
+}
+
+qint64 AwaitingTransactionModel::filterKeyFromValue(int role, const QVariant &value) const
+{
+    switch (role) {
+    case AmountRole:
+        return toCents(value.toDouble());
+    case DateRole:
+    case DayRole:
+        return value.typeId() == QMetaType::QString ? dayFromString(value.toString()) : value.toLongLong();
+    default:
+        return BaseModel::filterKeyFromValue(role, value);
+    }
+}
+
+void AwaitingTransactionModel::addAwaitingTransaction(const QString &description, double amount, const QString &date)
+{
+    AwaitingTransaction transaction{description, toCents(amount), 0};
+    transaction.day = dayFromString(date, &transaction.unparsedDate);
+    updateSortKey(transaction);
+    int row = insertSorted(m_awaitingTransactions, transaction, &AwaitingTransactionModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void AwaitingTransactionModel::updateAwaitingTransaction(int index, const QString &description, double amount, const QString &date)
@@ -60,13 +110,12 @@ void AwaitingTransactionModel::updateAwaitingTransaction(int index, const QStrin
     if (index < 0 || index >= m_awaitingTransactions.size())
         return;
 
-    m_awaitingTransactions[index] = {description, amount, date};
-
-    beginResetModel();
-    performSort();
-    endResetModel();
-
-    saveToFile();
+    QJsonObject before = entryToJson(index);
+    AwaitingTransaction transaction{description, toCents(amount), 0};
+    transaction.day = dayFromString(date, &transaction.unparsedDate);
+    updateSortKey(transaction);
+    int row = updateSorted(m_awaitingTransactions, index, transaction, &AwaitingTransactionModel::lessThan);
+    recordUpdate(before, row);
 }
 
 double AwaitingTransactionModel::getAwaitingTransactionAmount(int index) const
@@ -74,7 +123,7 @@ double AwaitingTransactionModel::getAwaitingTransactionAmount(int index) const
     if (index < 0 || index >= m_awaitingTransactions.size())
         return 0.0;
 
-    return m_awaitingTransactions.at(index).amount;
+    return fromCents(m_awaitingTransactions.at(index).amount);
 }
 
 void AwaitingTransactionModel::approveTransaction(int index)
@@ -84,33 +133,48 @@ void AwaitingTransactionModel::approveTransaction(int index)
 
     const AwaitingTransaction &transaction = m_awaitingTransactions.at(index);
 
-    emit transactionApproved(transaction.description, transaction.amount, transaction.date);
+    emit transactionApproved(transaction.description, fromCents(transaction.amount), dayToString(transaction.day, transaction.unparsedDate));
 
     removeEntry(index);
 }
 
 void AwaitingTransactionModel::performSort()
 {
-    std::stable_sort(m_awaitingTransactions.begin(), m_awaitingTransactions.end(), [this](const AwaitingTransaction &a, const AwaitingTransaction &b) {
-        bool result = false;
+    sortRows(m_awaitingTransactions, &AwaitingTransactionModel::lessThan, &AwaitingTransactionModel::updateSortKey);
+}
+
+bool AwaitingTransactionModel::lessThan(const AwaitingTransaction &a, const AwaitingTransaction &b) const
+{
+    switch (m_sortColumn) {
+    case SortByDescription:
+        return a.sortKey < b.sortKey;
+    case SortByAmount:
+        return a.amount < b.amount;
+    case SortByDate:
+    default:
+        return a.day < b.day;
+    }
+}
 
-        switch (m_sortColumn) {
-        case SortByDescription:
-            result = a.description.toLower() < b.description.toLower();
-            break;
-        case SortByAmount:
-            result = a.amount < b.amount;
-            break;
-        case SortByDate:
-            result = a.date < b.date;
-            break;
-        default:
-            result = a.date < b.date;
-            break;
-        }
+int AwaitingTransactionModel::filterRoleForSortColumn(int column) const
+{
+    switch (column) {
+    case SortByAmount:
+        return AmountRole;
+    case SortByDate:
+        return DateRole;
+    default:
+        return -1;
+    }
+}
 
-        return m_sortAscending ? result : !result;
-    });
+void AwaitingTransactionModel::updateSortKey(AwaitingTransaction &transaction) const
+{
+    if (m_sortColumn == SortByDescription) {
+        transaction.sortKey = transaction.description.toCaseFolded();
+    } else {
+        transaction.sortKey.clear();
+    }
 }
 
 QJsonObject AwaitingTransactionModel::entryToJson(int index) const
@@ -121,8 +185,8 @@ QJsonObject AwaitingTransactionModel::entryToJson(int index) const
     const AwaitingTransaction &trans = m_awaitingTransactions.at(index);
     QJsonObject obj;
     obj["description"] = trans.description;
-    obj["amount"] = trans.amount;
-    obj["date"] = trans.date;
+    obj["amount"] = fromCents(trans.amount);
+    obj["date"] = dayToString(trans.day, trans.unparsedDate);
     return obj;
 }
 
@@ -130,8 +194,9 @@ void AwaitingTransactionModel::entryFromJson(const QJsonObject &obj)
 {
     AwaitingTransaction trans;
     trans.description = obj["description"].toString();
-    trans.amount = obj["amount"].toDouble();
-    trans.date = obj["date"].toString();
+    trans.amount = toCents(obj["amount"].toDouble());
+    trans.day = dayFromString(obj["date"].toString(), &trans.unparsedDate);
+    updateSortKey(trans);
     m_awaitingTransactions.append(trans);
 }
 
@@ -1,6 +1,269 @@
 #include "basemodel.h"
 #include "remotedatabasemanager.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QPointer>
+#include <QDate>
+#include <QDateTime>
 #include <QDebug>
+#include <limits>
+
+static const int DefaultSaveDelay = 300;
+static const qint64 JournalCompactionThreshold = 256 * 1024;
+static const char ManifestFileName[] = "manifest.json";
+static const int ManifestVersion = 1;
+
+static QString snapshotHash(const QByteArray &snapshotData)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(snapshotData, QCryptographicHash::Sha1).toHex());
+}
+
+static QByteArray journalHeader(const QByteArray &snapshotData)
+{
+    // The journal only applies on top of the exact snapshot it was started from
+    QJsonObject header;
+    header["base"] = snapshotHash(snapshotData);
+    return QJsonDocument(header).toJson(QJsonDocument::Compact) + '\n';
+}
+
+// The helpers below run on the storage thread and only touch their arguments
+
+static QString currentSnapshotPath(const QString &jsonPath, const QString &binaryPath)
+{
+    // Both exist only if a format switch was interrupted, the newer one wins
+    QFileInfo jsonInfo(jsonPath);
+    QFileInfo binaryInfo(binaryPath);
+    if (!binaryInfo.exists())
+        return jsonPath;
+    if (!jsonInfo.exists())
+        return binaryPath;
+    return binaryInfo.lastModified() >= jsonInfo.lastModified() ? binaryPath : jsonPath;
+}
+
+static bool writeSnapshot(const QString &filePath, const QString &stalePath, const QString &journalPath,
+                          const QJsonArray &array, bool binary, quint16 flags)
+{
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    QByteArray snapshotData = binary ? BinaryStore::encode(array, flags) : QJsonDocument(array).toJson();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open file for writing:" << filePath;
+        return false;
+    }
+
+    file.write(snapshotData);
+    if (!file.commit()) {
+        qWarning() << "Could not write file:" << filePath;
+        return false;
+    }
+
+    // The snapshot in the other format is now outdated
+    if (QFile::exists(stalePath) && !QFile::remove(stalePath)) {
+        qWarning() << "Could not remove outdated file:" << stalePath;
+    }
+
+    // Everything journaled so far is now part of the snapshot
+    QSaveFile journal(journalPath);
+    if (!journal.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not reset journal:" << journalPath;
+        return false;
+    }
+
+    journal.write(journalHeader(snapshotData));
+    return journal.commit();
+}
+
+static bool appendJournalRecord(const QString &journalPath, const QString &snapshotPath, const QByteArray &line)
+{
+    QDir().mkpath(QFileInfo(journalPath).absolutePath());
+
+    QFile journal(journalPath);
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Could not open journal for writing:" << journalPath;
+        return false;
+    }
+
+    if (journal.size() == 0) {
+        QByteArray snapshotData;
+        QFile snapshot(snapshotPath);
+        if (snapshot.open(QIODevice::ReadOnly)) {
+            snapshotData = snapshot.readAll();
+        }
+        journal.write(journalHeader(snapshotData));
+    }
+
+    bool written = journal.write(line) == line.size();
+    return journal.flush() && written;
+}
+
+static QString segmentBaseName(const QString &key)
+{
+    // Entries without a key, like undated transactions, share one segment
+    return key.isEmpty() ? QStringLiteral("undated") : key;
+}
+
+static QMap<QString, QString> segmentFiles(const QString &dirPath)
+{
+    QMap<QString, QString> files;
+    QMap<QString, QDateTime> modified;
+
+    const QFileInfoList entries = QDir(dirPath).entryInfoList({"*.json", "*.bin"}, QDir::Files);
+    for (const QFileInfo &info : entries) {
+        if (info.fileName() == QLatin1String(ManifestFileName))
+            continue;
+
+        // Both formats exist only if a format switch was interrupted, the newer one wins
+        QString key = info.completeBaseName() == segmentBaseName(QString()) ? QString() : info.completeBaseName();
+        if (files.contains(key) && modified.value(key) >= info.lastModified())
+            continue;
+
+        files.insert(key, info.absoluteFilePath());
+        modified.insert(key, info.lastModified());
+    }
+    return files;
+}
+
+struct SegmentWrite {
+    QString key;
+    QJsonObject summary;
+    QJsonArray entries;
+};
+
+static bool writePartitions(const QString &dirPath, const QString &manifestPath, const QString &journalPath,
+                            const QStringList &legacyPaths, const QList<SegmentWrite> &writes,
+                            QStringList removedKeys, bool complete, bool binary, quint16 flags)
+{
+    QDir().mkpath(dirPath);
+
+    // Segments left alone keep their manifest entry as written last time
+    QMap<QString, QJsonObject> segments;
+    QFile previous(manifestPath);
+    if (previous.open(QIODevice::ReadOnly)) {
+        const QJsonArray listed = QJsonDocument::fromJson(previous.readAll()).object()["segments"].toArray();
+        for (const QJsonValue &value : listed) {
+            segments.insert(value["key"].toString(), value.toObject());
+        }
+        previous.close();
+    }
+
+    // Rewriting everything, whatever is not written no longer holds entries
+    if (complete) {
+        QSet<QString> written;
+        for (const SegmentWrite &write : writes) {
+            written.insert(write.key);
+        }
+        QStringList present = segments.keys() + segmentFiles(dirPath).keys();
+        for (const QString &key : std::as_const(present)) {
+            if (!written.contains(key) && !removedKeys.contains(key)) {
+                removedKeys.append(key);
+            }
+        }
+    }
+
+    QList<QByteArray> encoded;
+    encoded.reserve(writes.size());
+    QJsonObject announced;
+    for (const SegmentWrite &write : writes) {
+        encoded.append(binary ? BinaryStore::encode(write.entries, flags) : QJsonDocument(write.entries).toJson());
+        announced[write.key] = snapshotHash(encoded.last());
+    }
+    for (const QString &key : removedKeys) {
+        announced[key] = QString();
+    }
+
+    // Segments are committed one by one and the manifest last. The checkpoint
+    // tells a later load which segment contents this save produces, so one it
+    // never got to keeps getting the journal replayed onto it.
+    QJsonObject checkpoint;
+    checkpoint["op"] = "checkpoint";
+    checkpoint["segments"] = announced;
+    if (!appendJournalRecord(journalPath, manifestPath, QJsonDocument(checkpoint).toJson(QJsonDocument::Compact) + '\n'))
+        return false;
+
+    QString staleSuffix = binary ? ".json" : ".bin";
+    for (qsizetype i = 0; i < writes.size(); ++i) {
+        const SegmentWrite &write = writes.at(i);
+        const QByteArray &segmentData = encoded.at(i);
+        QString fileName = write.summary["file"].toString();
+        QString filePath = dirPath + "/" + fileName;
+
+        QSaveFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Could not open segment for writing:" << filePath;
+            return false;
+        }
+
+        file.write(segmentData);
+        if (!file.commit()) {
+            qWarning() << "Could not write segment:" << filePath;
+            return false;
+        }
+
+        QString stalePath = dirPath + "/" + segmentBaseName(write.key) + staleSuffix;
+        if (QFile::exists(stalePath) && !QFile::remove(stalePath)) {
+            qWarning() << "Could not remove outdated segment:" << stalePath;
+        }
+
+        QJsonObject summary = write.summary;
+        summary["bytes"] = qint64(segmentData.size());
+        summary["sha1"] = announced[write.key].toString();
+        segments.insert(write.key, summary);
+    }
+
+    // Emptied segments go before the manifest stops listing them, so a crash
+    // in between cannot bring their entries back
+    for (const QString &key : removedKeys) {
+        for (const char *suffix : {".json", ".bin"}) {
+            QString filePath = dirPath + "/" + segmentBaseName(key) + suffix;
+            if (QFile::exists(filePath) && !QFile::remove(filePath)) {
+                qWarning() << "Could not remove empty segment:" << filePath;
+            }
+        }
+        segments.remove(key);
+    }
+
+    QJsonArray listed;
+    for (const QJsonObject &segment : std::as_const(segments)) {
+        listed.append(segment);
+    }
+
+    QJsonObject manifest;
+    manifest["version"] = ManifestVersion;
+    manifest["segments"] = listed;
+    QByteArray manifestData = QJsonDocument(manifest).toJson();
+
+    QSaveFile manifestFile(manifestPath);
+    if (!manifestFile.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open manifest for writing:" << manifestPath;
+        return false;
+    }
+
+    manifestFile.write(manifestData);
+    if (!manifestFile.commit()) {
+        qWarning() << "Could not write manifest:" << manifestPath;
+        return false;
+    }
+
+    // The single-file snapshot from before partitioning is now outdated
+    for (const QString &legacyPath : legacyPaths) {
+        if (QFile::exists(legacyPath) && !QFile::remove(legacyPath)) {
+            qWarning() << "Could not remove outdated file:" << legacyPath;
+        }
+    }
+
+    // Everything journaled so far is now part of the segments
+    QSaveFile journal(journalPath);
+    if (!journal.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not reset journal:" << journalPath;
+        return false;
+    }
+
+    journal.write(journalHeader(manifestData));
+    return journal.commit();
+}
 
 BaseModel::BaseModel(const QString &fileName, QObject *parent)
     : QAbstractListModel(parent)
@@ -9,16 +272,43 @@ BaseModel::BaseModel(const QString &fileName, QObject *parent)
     , m_sortAscending(true)
     , m_isLoading(false)
     , m_sortTimer(new QTimer(this))
+    , m_saveTimer(new QTimer(this))
+    , m_pendingWrites(0)
+    , m_journalSize(0)
+    , m_sortKeyColumn(-1)
+    , m_pageSize(0)
+    , m_fetchedRows(0)
+    , m_mappedCount(0)
+    , m_allPartitionsDirty(true)
 {
     qDebug() << "BaseModel created for" << m_fileName;
 
     m_sortTimer->setSingleShot(true);
     m_sortTimer->setInterval(0);
-    connect(m_sortTimer, &QTimer::timeout, this, [this]() {
-        beginResetModel();
-        performSort();
-        endResetModel();
+    connect(m_sortTimer, &QTimer::timeout, this, &BaseModel::resort);
+
+    // Connected before any view, so the exposed row count is already right when views see the change
+    connect(this, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+        if (isPaged())
+            m_fetchedRows += last - first + 1;
+    });
+    connect(this, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last) {
+        if (isPaged())
+            m_fetchedRows -= last - first + 1;
+    });
+    connect(this, &QAbstractItemModel::modelReset, this, [this]() {
+        if (isPaged())
+            m_fetchedRows = qMin(m_pageSize, entryCount());
     });
+
+    // Mutations only mark the model dirty; bursts within the window are written once
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(DefaultSaveDelay);
+    connect(m_saveTimer, &QTimer::timeout, this, &BaseModel::writeToStorage);
+
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, &BaseModel::flush);
+    }
 }
 
 int BaseModel::rowCount(const QModelIndex &parent) const
@@ -27,14 +317,43 @@ int BaseModel::rowCount(const QModelIndex &parent) const
     return 0;
 }
 
+bool BaseModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && isPaged() && m_fetchedRows < entryCount();
+}
+
+void BaseModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    int count = qMin(m_pageSize, entryCount() - m_fetchedRows);
+    beginInsertRows(QModelIndex(), m_fetchedRows, m_fetchedRows + count - 1);
+    endInsertRows();
+}
+
+void BaseModel::fetchAll()
+{
+    while (canFetchMore(QModelIndex())) {
+        fetchMore(QModelIndex());
+    }
+}
+
+void BaseModel::setPageSize(int pageSize)
+{
+    m_pageSize = pageSize;
+    m_fetchedRows = isPaged() ? qMin(m_pageSize, entryCount()) : 0;
+}
+
 void BaseModel::removeEntry(int index)
 {
     if (index < 0 || index >= rowCount())
         return;
 
+    QJsonObject before = entryToJson(index);
     removeEntryFromModel(index);
     emit countChanged();
-    saveToFile();
+    recordRemove(before);
 }
 
 void BaseModel::ensureRemoteConnection()
@@ -62,6 +381,9 @@ void BaseModel::loadFromFile(bool remote)
 
     m_isLoading = true;
 
+    // Never let a pending write land on top of freshly loaded data
+    flush();
+
     qDebug() << "Loading" << m_fileName << "- useRemote:" << remote;
 
     if (remote) {
@@ -104,39 +426,240 @@ void BaseModel::loadFromLocal()
     endResetModel();
     emit countChanged();
 #else
-    QString filePath = getDataFilePath();
+    // Queued writes must reach the disk before it is read back
+    storageThreadPool()->waitForDone();
+
+    m_partitionSummaries.clear();
+    m_dirtyPartitions.clear();
+    m_allPartitionsDirty = false;
+
+    QString filePath = currentSnapshotPath(getDataFilePath(), getBinaryFilePath());
+
+    // A single-file snapshot left over from before partitioning is split on load
+    if (isPartitioned() && !QFile::exists(filePath)) {
+        loadPartitions();
+        return;
+    }
 
     beginResetModel();
     clearModel();
 
+    if (!isPartitioned() && mapSegments({filePath})) {
+        endResetModel();
+        emit countChanged();
+        qDebug() << "Mapped" << entryCount() << "entries from local file" << filePath;
+        return;
+    }
+
+    QByteArray fileData;
     QFile file(filePath);
     if (file.exists() && file.open(QIODevice::ReadOnly)) {
-        QByteArray jsonData = file.readAll();
+        fileData = file.readAll();
         file.close();
+    } else {
+        qDebug() << "No local data file found:" << filePath;
+    }
 
+    QJsonArray array;
+    bool binary = BinaryStore::isBinary(fileData);
+    if (binary) {
+        if (!BinaryStore::decode(fileData, &array)) {
+            qWarning() << "Binary snapshot is corrupted:" << filePath;
+        }
+    } else if (!fileData.isEmpty()) {
         QJsonParseError error;
-        QJsonDocument doc = QJsonDocument::fromJson(jsonData, &error);
+        QJsonDocument doc = QJsonDocument::fromJson(fileData, &error);
 
         if (error.error == QJsonParseError::NoError) {
-            QJsonArray array = doc.array();
-            for (const QJsonValue &value : array) {
-                QJsonObject obj = value.toObject();
-                entryFromJson(obj);
-            }
-            qDebug() << "Loaded" << array.size() << "entries from local file" << filePath;
+            array = doc.array();
         } else {
             qWarning() << "JSON parse error:" << error.errorString();
         }
-    } else {
-        qDebug() << "No local data file found:" << filePath << "- model cleared";
     }
 
+    int replayed = replayJournal(array, readJournal(fileData));
+
+    for (const QJsonValue &value : array) {
+        QJsonObject obj = value.toObject();
+        entryFromJson(obj);
+    }
+
+    // Edits journal a row by its current form. Rows saved by older versions
+    // (dates, cents, supplements written differently) would never match.
+    bool normalized = true;
+    if (!binary && isJournalEnabled()) {
+        int compared = qMin(entryCount(), int(array.size()));
+        for (int i = 0; normalized && i < compared; ++i) {
+            normalized = QJsonDocument(array.at(i).toObject()).toJson(QJsonDocument::Compact)
+                         == QJsonDocument(entryToJson(i)).toJson(QJsonDocument::Compact);
+        }
+    }
+    qDebug() << "Loaded" << array.size() << "entries from local file" << filePath
+             << "(" << replayed << "journal records replayed)";
+
     performSort();
     endResetModel();
     emit countChanged();
+
+    if (isPartitioned() && !fileData.isEmpty()) {
+        qDebug() << "Splitting" << m_fileName << "into segments";
+        saveToFile();
+    } else if (!fileData.isEmpty() && binary != isBinaryStorageEnabled()) {
+        // Rewrite existing files in the configured format
+        qDebug() << "Migrating" << m_fileName << "to" << (binary ? "JSON" : "binary") << "storage";
+        saveToFile();
+    } else if (replayed > 0 && binary && supportsMappedSnapshot()) {
+        // Fold the journal in so the next start can map the snapshot again
+        saveToFile();
+    }
+
+    if (!normalized) {
+        // Queued now, ahead of the first journal record
+        qDebug() << "Rewriting" << m_fileName << "entries in their current form";
+        saveToFile();
+        flush();
+    }
 #endif
 }
 
+void BaseModel::loadPartitions()
+{
+    QByteArray manifestData;
+    QFile manifestFile(getManifestFilePath());
+    if (manifestFile.open(QIODevice::ReadOnly)) {
+        manifestData = manifestFile.readAll();
+        manifestFile.close();
+    }
+
+    const QJsonArray listed = QJsonDocument::fromJson(manifestData).object()["segments"].toArray();
+    for (const QJsonValue &value : listed) {
+        m_partitionSummaries.insert(value["key"].toString(), value.toObject());
+    }
+
+    // A save that never finished leaves segments the manifest does not describe
+    QMap<QString, QString> files = segmentFiles(getPartitionDirPath());
+    QSet<QString> stale;
+    for (auto it = m_partitionSummaries.cbegin(); it != m_partitionSummaries.cend(); ++it) {
+        QFileInfo info(files.value(it.key()));
+        if (!files.contains(it.key()) || info.fileName() != it.value()["file"].toString()
+            || info.size() != it.value()["bytes"].toInteger()) {
+            stale.insert(it.key());
+        }
+    }
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        if (!m_partitionSummaries.contains(it.key()))
+            stale.insert(it.key());
+    }
+
+    beginResetModel();
+    clearModel();
+
+    QStringList paths = files.values();
+    if (!m_sortAscending) {
+        std::reverse(paths.begin(), paths.end());
+    }
+
+    if (stale.isEmpty() && partitionsFollowSort() && mapSegments(paths)) {
+        endResetModel();
+        emit countChanged();
+        qDebug() << "Mapped" << entryCount() << "entries from" << paths.size() << "segments of" << m_fileName;
+        return;
+    }
+
+    // Each save checkpoints the segment contents it is about to write. A segment
+    // matching a checkpoint holds every record journaled before it.
+    QList<QJsonObject> records = readJournal(manifestData);
+    QList<QJsonObject> checkpoints;
+    for (const QJsonObject &record : std::as_const(records)) {
+        if (record["op"].toString() == "checkpoint") {
+            checkpoints.append(record["segments"].toObject());
+        }
+    }
+
+    auto checkpointOf = [&checkpoints](const QString &key, const QString &sha1) {
+        for (qsizetype i = checkpoints.size(); i > 0; --i) {
+            QJsonValue announced = checkpoints.at(i - 1).value(key);
+            if (announced.isString() && announced.toString() == sha1)
+                return int(i);
+        }
+        return -1;
+    };
+
+    QHash<QString, int> segmentCheckpoints;
+    QJsonArray array;
+    bool binary = isBinaryStorageEnabled();
+    bool otherFormat = false;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        QFile file(it.value());
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Could not open segment:" << it.value();
+            continue;
+        }
+
+        QByteArray segmentData = file.readAll();
+        QString sha1 = snapshotHash(segmentData);
+        if (sha1 != m_partitionSummaries.value(it.key())["sha1"].toString()) {
+            int passed = checkpointOf(it.key(), sha1);
+            if (passed < 0) {
+                // Nothing says which records it holds, replaying any could duplicate entries
+                qWarning() << "Segment" << it.value() << "matches neither its manifest nor the journal - keeping it as is";
+                passed = std::numeric_limits<int>::max();
+            }
+            segmentCheckpoints.insert(it.key(), passed);
+            stale.insert(it.key());
+        }
+
+        QJsonArray entries;
+        if (BinaryStore::isBinary(segmentData)) {
+            if (!BinaryStore::decode(segmentData, &entries)) {
+                qWarning() << "Binary segment is corrupted:" << it.value();
+            }
+            otherFormat |= !binary;
+        } else {
+            entries = QJsonDocument::fromJson(segmentData).array();
+            otherFormat |= binary;
+        }
+
+        for (const QJsonValue &value : std::as_const(entries)) {
+            array.append(value);
+        }
+    }
+
+    // A listed segment that is gone was emptied by the save that removed it
+    for (auto it = m_partitionSummaries.cbegin(); it != m_partitionSummaries.cend(); ++it) {
+        if (!files.contains(it.key())) {
+            int passed = checkpointOf(it.key(), QString());
+            if (passed < 0) {
+                qWarning() << "Segment" << it.key() << "of" << m_fileName << "is missing";
+                passed = 0;
+            }
+            segmentCheckpoints.insert(it.key(), passed);
+        }
+    }
+
+    int replayed = replayJournal(array, records, &segmentCheckpoints);
+    m_dirtyPartitions.unite(stale);
+
+    for (const QJsonValue &value : std::as_const(array)) {
+        QJsonObject obj = value.toObject();
+        entryFromJson(obj);
+    }
+    qDebug() << "Loaded" << array.size() << "entries from" << files.size() << "segments of" << m_fileName
+             << "(" << replayed << "journal records replayed)";
+
+    performSort();
+    endResetModel();
+    emit countChanged();
+
+    if (otherFormat) {
+        qDebug() << "Migrating" << m_fileName << "segments to" << (binary ? "binary" : "JSON") << "storage";
+        saveToFile();
+    } else if (!stale.isEmpty() || (replayed > 0 && binary && supportsMappedSnapshot())) {
+        // Rewrites only the segments the journal touched, or the ones the manifest got wrong
+        scheduleWrite();
+    }
+}
+
 void BaseModel::loadFromRemote()
 {
     ensureRemoteConnection();
@@ -153,7 +676,7 @@ void BaseModel::loadFromRemote()
 
 void BaseModel::clear()
 {
-    if (rowCount() == 0)
+    if (entryCount() == 0)
         return;
 
     beginResetModel();
@@ -161,7 +684,7 @@ void BaseModel::clear()
     endResetModel();
 
     emit countChanged();
-    saveToFile();
+    recordClear();
 }
 
 void BaseModel::sortBy(int column)
@@ -179,17 +702,216 @@ void BaseModel::sortBy(int column)
     m_sortTimer->start();
 }
 
+void BaseModel::resort()
+{
+    m_sortTimer->stop();
+
+    beginResetModel();
+    performSort();
+    endResetModel();
+}
+
+QString BaseModel::searchText(int row) const
+{
+    QModelIndex modelIndex = index(row, 0);
+    QStringList fields;
+
+    for (int role : searchRoles()) {
+        fields << data(modelIndex, role).toString();
+    }
+    return fields.join('\n');
+}
+
+bool BaseModel::filterKey(int row, int role, qint64 *key) const
+{
+    QVariant value = data(index(row, 0), role);
+
+    switch (value.typeId()) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        *key = value.toLongLong();
+        return true;
+    default:
+        return false;
+    }
+}
+
+qint64 BaseModel::filterKeyFromValue(int role, const QVariant &value) const
+{
+    Q_UNUSED(role)
+    return value.toLongLong();
+}
+
+int BaseModel::sortedFilterRole() const
+{
+    // A pending sort means the rows are still in the previous column's order
+    if (m_sortTimer->isActive())
+        return -1;
+
+    return filterRoleForSortColumn(m_sortColumn);
+}
+
+void BaseModel::setSaveDelay(int delay)
+{
+    delay = qMax(0, delay);
+    if (m_saveTimer->interval() == delay)
+        return;
+
+    m_saveTimer->setInterval(delay);
+    emit saveDelayChanged();
+}
+
 void BaseModel::saveToFile()
 {
-    QJsonArray array;
+    // Callers replace the content wholesale, no segment can be assumed unchanged
+    m_allPartitionsDirty = true;
+    scheduleWrite();
+}
 
-    for (int i = 0; i < rowCount(); ++i) {
-        array.append(entryToJson(i));
+void BaseModel::scheduleWrite()
+{
+    // The first mutation opens the window; later ones within it ride along
+    if (!m_saveTimer->isActive())
+        m_saveTimer->start();
+}
+
+void BaseModel::markPartitionDirty(const QJsonObject &entry)
+{
+    if (isPartitioned()) {
+        m_dirtyPartitions.insert(partitionKey(entry));
+    }
+}
+
+void BaseModel::recordInsert(int index)
+{
+    if (!isJournalEnabled()) {
+        saveToFile();
+        return;
+    }
+
+    QJsonObject record;
+    record["op"] = "insert";
+    record["entry"] = entryToJson(index);
+    markPartitionDirty(record["entry"].toObject());
+    appendToJournal(record);
+}
+
+void BaseModel::recordUpdate(const QJsonObject &before, int index)
+{
+    if (!isJournalEnabled()) {
+        saveToFile();
+        return;
+    }
+
+    QJsonObject record;
+    record["op"] = "update";
+    record["before"] = before;
+    record["entry"] = entryToJson(index);
+    markPartitionDirty(before);
+    markPartitionDirty(record["entry"].toObject());
+    appendToJournal(record);
+}
+
+void BaseModel::recordRemove(const QJsonObject &before)
+{
+    if (!isJournalEnabled()) {
+        saveToFile();
+        return;
+    }
+
+    QJsonObject record;
+    record["op"] = "remove";
+    record["before"] = before;
+    markPartitionDirty(before);
+    appendToJournal(record);
+}
+
+void BaseModel::recordClear()
+{
+    if (!isJournalEnabled()) {
+        saveToFile();
+        return;
+    }
+
+    QJsonObject record;
+    record["op"] = "clear";
+    m_allPartitionsDirty = true;
+    appendToJournal(record);
+}
+
+void BaseModel::flush()
+{
+    if (m_saveTimer->isActive()) {
+        m_saveTimer->stop();
+        writeToStorage();
+    }
+
+    storageThreadPool()->waitForDone();
+}
+
+QThreadPool *BaseModel::storageThreadPool()
+{
+    // A single thread keeps snapshot writes and journal appends in submission order
+    static QThreadPool *pool = [] {
+        QThreadPool *threadPool = new QThreadPool(QCoreApplication::instance());
+        threadPool->setMaxThreadCount(1);
+        threadPool->setExpiryTimeout(-1);
+        return threadPool;
+    }();
+    return pool;
+}
+
+void BaseModel::runStorageTask(const std::function<bool()> &task, bool fullSaveOnFailure)
+{
+    if (m_pendingWrites++ == 0) {
+        emit savingChanged();
     }
 
+    QPointer<BaseModel> self(this);
+    storageThreadPool()->start([self, task, fullSaveOnFailure]() {
+        bool success = task();
+
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, success, fullSaveOnFailure]() {
+            if (!self)
+                return;
+
+            if (--self->m_pendingWrites == 0) {
+                emit self->savingChanged();
+            }
+            emit self->saveCompleted(success);
+
+            if (!success && fullSaveOnFailure) {
+                qWarning() << "Storage write failed for" << self->m_fileName << "- falling back to full save";
+                self->saveToFile();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void BaseModel::writeToStorage()
+{
+    // A pending re-sort means the rows are not in the advertised order yet
+    quint16 snapshotFlags = m_sortTimer->isActive() ? 0 : sortFlags();
+
     QSettings settings("Odizinne", "GTACOMPTA");
     bool useRemote = settings.value("useRemoteDatabase", false).toBool();
 
+#ifndef Q_OS_WASM
+    if (!useRemote && isPartitioned()) {
+        saveToPartitions(snapshotFlags);
+        return;
+    }
+#endif
+
+    QJsonArray array;
+
+    for (int i = 0; i < entryCount(); ++i) {
+        array.append(entryToJson(i));
+    }
+
     if (useRemote) {
         ensureRemoteConnection();
 
@@ -201,35 +923,175 @@ void BaseModel::saveToFile()
             remoteManager->saveData(m_fileName, payload);
         } else {
             qWarning() << "RemoteDatabaseManager not available, falling back to local";
-            saveToLocal(array);
+            saveToLocal(array, snapshotFlags);
         }
     } else {
-        saveToLocal(array);
+        saveToLocal(array, snapshotFlags);
     }
 }
 
-void BaseModel::saveToLocal(const QJsonArray &array)
+void BaseModel::saveToLocal(const QJsonArray &array, quint16 snapshotFlags)
 {
-    QJsonDocument doc(array);
-
 #ifdef Q_OS_WASM
+    Q_UNUSED(snapshotFlags)
+    QJsonDocument doc(array);
     QSettings settings("Odizinne", "GTACOMPTA");
     settings.setValue(m_fileName, doc.toJson(QJsonDocument::Compact));
     settings.sync();
 #else
-    QString filePath = getDataFilePath();
-    QFileInfo fileInfo(filePath);
-    QDir().mkpath(fileInfo.absolutePath());
+    // Serializing and writing happen off the GUI thread, the array is an implicitly shared copy
+    bool binary = isBinaryStorageEnabled();
+    QString filePath = binary ? getBinaryFilePath() : getDataFilePath();
+    QString stalePath = binary ? getDataFilePath() : getBinaryFilePath();
+    QString journalPath = getJournalFilePath();
+    m_journalSize = 0;
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Could not open file for writing:" << filePath;
-        return;
+    runStorageTask([filePath, stalePath, journalPath, array, binary, snapshotFlags]() {
+        return writeSnapshot(filePath, stalePath, journalPath, array, binary, snapshotFlags);
+    });
+#endif
+}
+
+void BaseModel::saveToPartitions(quint16 snapshotFlags)
+{
+    bool binary = isBinaryStorageEnabled();
+    QString suffix = binary ? ".bin" : ".json";
+
+    // A format switch rewrites every segment in the new format
+    for (const QJsonObject &summary : std::as_const(m_partitionSummaries)) {
+        if (!summary["file"].toString().endsWith(suffix)) {
+            m_allPartitionsDirty = true;
+            break;
+        }
     }
 
-    file.write(doc.toJson());
-    file.close();
-#endif
+    QMap<QString, QList<int>> rows = partitionRows(m_dirtyPartitions, m_allPartitionsDirty);
+    bool complete = m_allPartitionsDirty;
+    QSet<QString> keys = m_dirtyPartitions;
+    if (complete) {
+        keys = QSet<QString>(m_partitionSummaries.keyBegin(), m_partitionSummaries.keyEnd());
+        keys.unite(QSet<QString>(rows.keyBegin(), rows.keyEnd()));
+    }
+
+    QList<SegmentWrite> writes;
+    QStringList removedKeys;
+    for (const QString &key : std::as_const(keys)) {
+        auto it = rows.constFind(key);
+        if (it == rows.constEnd()) {
+            removedKeys.append(key);
+            m_partitionSummaries.remove(key);
+            continue;
+        }
+
+        QJsonArray entries;
+        for (int index : it.value()) {
+            entries.append(entryToJson(index));
+        }
+
+        QJsonObject summary = summarizePartition(key, it.value());
+        summary["file"] = segmentBaseName(key) + suffix;
+        m_partitionSummaries.insert(key, summary);
+        writes.append({key, summary, entries});
+    }
+
+    m_dirtyPartitions.clear();
+    m_allPartitionsDirty = false;
+    m_journalSize = 0;
+
+    qDebug() << "Writing" << writes.size() << "of" << m_partitionSummaries.size() << "segments of" << m_fileName;
+
+    QString dirPath = getPartitionDirPath();
+    QString manifestPath = getManifestFilePath();
+    QString journalPath = getJournalFilePath();
+    QStringList legacyPaths = {getDataFilePath(), getBinaryFilePath()};
+
+    // The dirty set is gone, a failed save can only be retried in full
+    runStorageTask([dirPath, manifestPath, journalPath, legacyPaths, writes, removedKeys, complete, binary, snapshotFlags]() {
+        return writePartitions(dirPath, manifestPath, journalPath, legacyPaths, writes, removedKeys, complete, binary, snapshotFlags);
+    }, true);
+}
+
+QMap<QString, QList<int>> BaseModel::partitionRows(const QSet<QString> &keys, bool all) const
+{
+    QMap<QString, QList<int>> rows;
+
+    // A few dirty keys are looked up instead of walking every row
+    if (!all && !m_sortTimer->isActive()) {
+        bool spanned = true;
+        for (const QString &key : keys) {
+            int begin = 0;
+            int end = 0;
+            if (!partitionSpan(key, &begin, &end)) {
+                spanned = false;
+                break;
+            }
+
+            QList<int> &indexes = rows[key];
+            for (int i = begin; i < end; ++i) {
+                indexes.append(i);
+            }
+            if (indexes.isEmpty()) {
+                rows.remove(key);
+            }
+        }
+        if (spanned)
+            return rows;
+        rows.clear();
+    }
+
+    // Rows of a key mostly follow each other, the previous list is reused until the key changes
+    QString currentKey;
+    QList<int> *current = nullptr;
+    for (int i = 0; i < entryCount(); ++i) {
+        QString key = entryPartition(i);
+        if (i == 0 || key != currentKey) {
+            current = (all || keys.contains(key)) ? &rows[key] : nullptr;
+            currentKey = key;
+        }
+        if (current) {
+            current->append(i);
+        }
+    }
+    return rows;
+}
+
+QJsonObject BaseModel::summarizePartition(const QString &key, const QList<int> &indexes) const
+{
+    QJsonObject summary = partitionSummary(indexes);
+    summary["key"] = key;
+    summary["count"] = indexes.size();
+    return summary;
+}
+
+QVariantList BaseModel::partitionSummaries() const
+{
+    QVariantList list;
+    if (!isPartitioned())
+        return list;
+
+    QMap<QString, QJsonObject> summaries = m_partitionSummaries;
+    if (m_allPartitionsDirty || !m_dirtyPartitions.isEmpty()) {
+        if (m_allPartitionsDirty) {
+            summaries.clear();
+        }
+        for (const QString &key : m_dirtyPartitions) {
+            summaries.remove(key);
+        }
+
+        QMap<QString, QList<int>> rows = partitionRows(m_dirtyPartitions, m_allPartitionsDirty);
+        for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+            summaries.insert(it.key(), summarizePartition(it.key(), it.value()));
+        }
+    }
+
+    for (QJsonObject summary : std::as_const(summaries)) {
+        // Where and how a segment is stored is of no interest outside the model
+        summary.remove("file");
+        summary.remove("bytes");
+        summary.remove("sha1");
+        list.append(summary.toVariantMap());
+    }
+    return list;
 }
 
 void BaseModel::onRemoteDataLoaded(const QString &collection, const QJsonObject &data)
@@ -254,11 +1116,12 @@ void BaseModel::onRemoteDataLoaded(const QString &collection, const QJsonObject
     }
 
     performSort();
+    m_allPartitionsDirty = true;
 
     endResetModel();
     emit countChanged();
 
-    qDebug() << "Model reset complete for" << m_fileName << ". New row count:" << rowCount();
+    qDebug() << "Model reset complete for" << m_fileName << ". New row count:" << entryCount();
 }
 
 void BaseModel::onRemoteDataSaved(const QString &collection, bool success)
@@ -272,6 +1135,289 @@ void BaseModel::onRemoteDataSaved(const QString &collection, bool success)
     }
 }
 
+bool BaseModel::isBinaryStorageEnabled()
+{
+#ifdef Q_OS_WASM
+    return false;
+#else
+    QSettings settings("Odizinne", "GTACOMPTA");
+    return settings.value("useBinaryStorage", false).toBool();
+#endif
+}
+
+bool BaseModel::isJournalEnabled() const
+{
+#ifdef Q_OS_WASM
+    return false;
+#else
+    // The remote server only understands whole collections
+    QSettings settings("Odizinne", "GTACOMPTA");
+    return !settings.value("useRemoteDatabase", false).toBool();
+#endif
+}
+
+void BaseModel::appendToJournal(const QJsonObject &record)
+{
+    QString journalPath = getJournalFilePath();
+    QString jsonPath = getDataFilePath();
+    QString binaryPath = getBinaryFilePath();
+    QString manifestPath = isPartitioned() ? getManifestFilePath() : QString();
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+    m_journalSize += line.size();
+
+    runStorageTask([journalPath, jsonPath, binaryPath, manifestPath, line]() {
+        // A partitioned collection journals on top of its manifest
+        QString snapshotPath = manifestPath.isEmpty() ? currentSnapshotPath(jsonPath, binaryPath) : manifestPath;
+        return appendJournalRecord(journalPath, snapshotPath, line);
+    }, true);
+
+    if (m_journalSize > JournalCompactionThreshold) {
+        qDebug() << "Journal for" << m_fileName << "exceeds" << JournalCompactionThreshold << "bytes - compacting";
+        scheduleWrite();
+    }
+}
+
+QList<QJsonObject> BaseModel::readJournal(const QByteArray &snapshotData)
+{
+    QList<QJsonObject> records;
+
+    QFile journal(getJournalFilePath());
+    if (!journal.open(QIODevice::ReadOnly)) {
+        m_journalSize = 0;
+        return records;
+    }
+    m_journalSize = journal.size();
+
+    QJsonObject header = QJsonDocument::fromJson(journal.readLine()).object();
+    if (header["base"].toString() != snapshotHash(snapshotData)) {
+        qDebug() << "Journal for" << m_fileName << "does not match the current snapshot - ignoring";
+        return records;
+    }
+
+    while (!journal.atEnd()) {
+        QByteArray line = journal.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        QJsonParseError error;
+        QJsonObject record = QJsonDocument::fromJson(line, &error).object();
+        if (error.error != QJsonParseError::NoError) {
+            // A torn tail from an interrupted append, everything before it is intact
+            qWarning() << "Truncated journal record for" << m_fileName << "- stopping replay";
+            break;
+        }
+        records.append(record);
+    }
+
+    return records;
+}
+
+int BaseModel::replayJournal(QJsonArray &array, const QList<QJsonObject> &records,
+                             const QHash<QString, int> *segmentCheckpoints)
+{
+    if (records.isEmpty())
+        return 0;
+
+    // Rows have no ids, an entry is identified by its previous content. Removed
+    // rows leave a hole until the end so the slots of the others stay put.
+    QList<QJsonValue> rows;
+    rows.reserve(array.size());
+    for (const QJsonValue &value : std::as_const(array)) {
+        rows.append(value);
+    }
+    QList<bool> removed(rows.size(), false);
+    QHash<QByteArray, QList<int>> slotsByContent;
+    bool indexed = false;
+
+    auto contentKey = [](const QJsonValue &value) {
+        return QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact);
+    };
+    auto addSlot = [&slotsByContent, &contentKey](const QJsonValue &value, int slot) {
+        QList<int> &matches = slotsByContent[contentKey(value)];
+        matches.insert(std::lower_bound(matches.begin(), matches.end(), slot) - matches.begin(), slot);
+    };
+    auto takeSlot = [&slotsByContent, &contentKey](const QJsonValue &value) {
+        auto it = slotsByContent.find(contentKey(value));
+        if (it == slotsByContent.end())
+            return -1;
+
+        // The first matching row, as a scan from the top would find
+        int slot = it->takeFirst();
+        if (it->isEmpty()) {
+            slotsByContent.erase(it);
+        }
+        return slot;
+    };
+
+    // A segment written by an unfinished save already holds the records
+    // journaled before that save's checkpoint, they only apply to the others
+    int checkpointsPassed = 0;
+    auto applies = [this, segmentCheckpoints, &checkpointsPassed](const QJsonValue &value) {
+        return !segmentCheckpoints
+               || checkpointsPassed >= segmentCheckpoints->value(partitionKey(value.toObject()), 0);
+    };
+
+    int replayed = 0;
+    for (const QJsonObject &record : records) {
+        QString op = record["op"].toString();
+        if (op == "checkpoint") {
+            ++checkpointsPassed;
+            continue;
+        }
+
+        if (record.contains("before"))
+            markPartitionDirty(record["before"].toObject());
+        if (record.contains("entry"))
+            markPartitionDirty(record["entry"].toObject());
+
+        if (op == "insert") {
+            if (applies(record["entry"])) {
+                rows.append(record["entry"]);
+                removed.append(false);
+                if (indexed) {
+                    addSlot(rows.last(), rows.size() - 1);
+                }
+            }
+        } else if (op == "clear") {
+            for (int slot = 0; slot < rows.size(); ++slot) {
+                if (!removed.at(slot) && applies(rows.at(slot))) {
+                    removed[slot] = true;
+                    rows[slot] = QJsonValue();
+                }
+            }
+            slotsByContent.clear();
+            indexed = false;
+            m_allPartitionsDirty = true;
+        } else if (op == "update" || op == "remove") {
+            // Built on the first lookup, journals of plain inserts never pay for it
+            if (!indexed) {
+                for (int slot = 0; slot < rows.size(); ++slot) {
+                    if (!removed.at(slot)) {
+                        addSlot(rows.at(slot), slot);
+                    }
+                }
+                indexed = true;
+            }
+
+            // An update moving an entry between segments may apply to only one side
+            int slot = applies(record["before"]) ? takeSlot(record["before"]) : -1;
+            if (op == "update" && applies(record["entry"])) {
+                if (slot < 0) {
+                    rows.append(QJsonValue());
+                    removed.append(false);
+                    slot = rows.size() - 1;
+                }
+                rows[slot] = record["entry"];
+                addSlot(rows.at(slot), slot);
+            } else if (slot >= 0) {
+                removed[slot] = true;
+                rows[slot] = QJsonValue();
+            }
+        }
+        ++replayed;
+    }
+
+    array = QJsonArray();
+    for (int slot = 0; slot < rows.size(); ++slot) {
+        if (!removed.at(slot)) {
+            array.append(rows.at(slot));
+        }
+    }
+
+    return replayed;
+}
+
+bool BaseModel::hasJournalRecords() const
+{
+    QFile journal(getJournalFilePath());
+    if (!journal.open(QIODevice::ReadOnly))
+        return false;
+
+    // Anything past the header line still has to be replayed
+    journal.readLine();
+    return !journal.atEnd();
+}
+
+bool BaseModel::mapSegments(const QStringList &filePaths)
+{
+    if (filePaths.isEmpty() || !supportsMappedSnapshot() || !isBinaryStorageEnabled() || hasJournalRecords())
+        return false;
+
+    for (const QString &filePath : filePaths) {
+        QSharedPointer<QFile> file(new QFile(filePath));
+        uchar *data = file->open(QIODevice::ReadOnly) ? file->map(0, file->size()) : nullptr;
+        BinaryStore store = data ? BinaryStore(data, file->size()) : BinaryStore();
+
+        // Rows are served in file order, which must be the order performSort() would produce
+        if (!store.isValid() || store.flags() != sortFlags()) {
+            releaseSnapshot();
+            return false;
+        }
+
+        m_mappedSegments.append({file, store, m_mappedCount});
+        m_mappedCount += store.recordCount();
+    }
+
+    m_journalSize = QFileInfo(getJournalFilePath()).size();
+    return true;
+}
+
+QJsonValue BaseModel::mappedRecord(int index) const
+{
+    // The last segment starting at or before index holds it
+    auto it = std::upper_bound(m_mappedSegments.cbegin(), m_mappedSegments.cend(), index,
+                               [](int entry, const MappedSegment &segment) { return entry < segment.first; });
+    if (it == m_mappedSegments.cbegin())
+        return QJsonValue();
+
+    --it;
+    return it->store.record(index - it->first);
+}
+
+void BaseModel::releaseSnapshot()
+{
+    // Closing the files unmaps them
+    m_mappedSegments.clear();
+    m_mappedCount = 0;
+}
+
+quint16 BaseModel::sortFlags() const
+{
+    quint16 flags = BinaryStore::SortedFlag | (m_sortColumn & BinaryStore::SortColumnMask);
+    if (m_sortAscending)
+        flags |= BinaryStore::AscendingFlag;
+    return flags;
+}
+
+qint64 BaseModel::dayFromString(const QString &date, QString *unparsed)
+{
+    QString text = date.trimmed();
+    QDate parsed = QDate::fromString(text, Qt::ISODate);
+    if (!parsed.isValid()) {
+        parsed = QDateTime::fromString(text, Qt::ISODate).date();
+    }
+
+    // Hand-edited files from before dates were normalized
+    static const char *const legacyFormats[] = {"dd/MM/yyyy", "yyyy/MM/dd", "dd.MM.yyyy", "dd-MM-yyyy"};
+    for (const char *format : legacyFormats) {
+        if (parsed.isValid())
+            break;
+        parsed = QDate::fromString(text, QString::fromLatin1(format));
+    }
+
+    if (unparsed) {
+        *unparsed = parsed.isValid() ? QString() : date;
+    }
+
+    // 0 stands for a missing date and sorts before every real one
+    return parsed.isValid() ? parsed.toJulianDay() : 0;
+}
+
+QString BaseModel::dayToString(qint64 day, const QString &unparsed)
+{
+    return day > 0 ? QDate::fromJulianDay(day).toString(Qt::ISODate) : unparsed;
+}
+
 QString BaseModel::getDataFilePath() const
 {
 #ifdef Q_OS_WASM
@@ -281,3 +1427,25 @@ QString BaseModel::getDataFilePath() const
     return dataPath + "/" + m_fileName;
 #endif
 }
+
+QString BaseModel::getBinaryFilePath() const
+{
+    QFileInfo info(getDataFilePath());
+    return info.path() + "/" + info.completeBaseName() + ".bin";
+}
+
+QString BaseModel::getJournalFilePath() const
+{
+    return getDataFilePath() + ".journal";
+}
+
+QString BaseModel::getPartitionDirPath() const
+{
+    QFileInfo info(getDataFilePath());
+    return info.path() + "/" + info.completeBaseName();
+}
+
+QString BaseModel::getManifestFilePath() const
+{
+    return getPartitionDirPath() + "/" + ManifestFileName;
+}
@@ -0,0 +1,453 @@
+#include "binarystore.h"
+#include <QDate>
+#include <QJsonObject>
+#include <QtEndian>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+namespace {
+
+enum ValueTag : quint8 {
+    NullTag = 0,
+    FalseTag,
+    TrueTag,
+    IntegerTag,
+    CentsTag,
+    DoubleTag,
+    StringTag,
+    DateTag,
+    ObjectTag,
+    ArrayTag
+};
+
+const char Magic[4] = { 'G', 'T', 'A', 'B' };
+const int HeaderSize = 32;
+const int MaxDepth = 32;
+const qint64 EpochJulianDay = 2440588; // 1970-01-01
+const double MaxExactInteger = 9007199254740992.0; // 2^53
+
+void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+void writeSigned(QByteArray &out, qint64 value)
+{
+    writeVarint(out, (quint64(value) << 1) ^ quint64(value >> 63));
+}
+
+void writeUInt32(QByteArray &out, quint32 value)
+{
+    char buffer[4];
+    qToLittleEndian(value, buffer);
+    out.append(buffer, 4);
+}
+
+bool readVarint(const uchar *&pos, const uchar *end, quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        uchar byte = *pos++;
+        result |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool readSigned(const uchar *&pos, const uchar *end, qint64 *value)
+{
+    quint64 raw;
+    if (!readVarint(pos, end, &raw))
+        return false;
+
+    *value = qint64(raw >> 1) ^ -qint64(raw & 1);
+    return true;
+}
+
+bool isDateString(const QString &text, QDate *date)
+{
+    if (text.size() != 10 || text.at(4) != u'-' || text.at(7) != u'-')
+        return false;
+
+    // Only exact round trips are stored as days, anything else stays a string
+    QDate parsed = QDate::fromString(text, Qt::ISODate);
+    if (!parsed.isValid() || parsed.toString(Qt::ISODate) != text)
+        return false;
+
+    *date = parsed;
+    return true;
+}
+
+class Encoder
+{
+public:
+    void writeValue(QByteArray &out, const QJsonValue &value)
+    {
+        switch (value.type()) {
+        case QJsonValue::Bool:
+            out.append(char(value.toBool() ? TrueTag : FalseTag));
+            break;
+        case QJsonValue::Double:
+            writeNumber(out, value.toDouble());
+            break;
+        case QJsonValue::String: {
+            QString text = value.toString();
+            QDate date;
+            if (isDateString(text, &date)) {
+                out.append(char(DateTag));
+                writeSigned(out, date.toJulianDay() - EpochJulianDay);
+            } else {
+                out.append(char(StringTag));
+                writeVarint(out, intern(text));
+            }
+            break;
+        }
+        case QJsonValue::Array: {
+            QJsonArray array = value.toArray();
+            out.append(char(ArrayTag));
+            writeVarint(out, array.size());
+            for (const QJsonValue &item : array) {
+                writeValue(out, item);
+            }
+            break;
+        }
+        case QJsonValue::Object: {
+            QJsonObject object = value.toObject();
+            out.append(char(ObjectTag));
+            writeVarint(out, object.size());
+            for (auto it = object.begin(); it != object.end(); ++it) {
+                writeVarint(out, intern(it.key()));
+                writeValue(out, it.value());
+            }
+            break;
+        }
+        default:
+            out.append(char(NullTag));
+            break;
+        }
+    }
+
+    QByteArray strings() const
+    {
+        QByteArray bytes;
+        for (const QByteArray &text : m_strings) {
+            bytes.append(text);
+        }
+        return bytes;
+    }
+
+    QList<quint32> stringOffsets(quint32 base) const
+    {
+        QList<quint32> offsets;
+        offsets.reserve(m_strings.size() + 1);
+        quint32 offset = base;
+        for (const QByteArray &text : m_strings) {
+            offsets.append(offset);
+            offset += text.size();
+        }
+        offsets.append(offset);
+        return offsets;
+    }
+
+    int stringCount() const { return m_strings.size(); }
+
+private:
+    void writeNumber(QByteArray &out, double number)
+    {
+        double integral;
+        if (std::isfinite(number) && std::modf(number, &integral) == 0.0 && std::abs(number) < MaxExactInteger) {
+            out.append(char(IntegerTag));
+            writeSigned(out, qint64(number));
+            return;
+        }
+
+        if (std::isfinite(number) && std::abs(number) < MaxExactInteger / 100.0) {
+            qint64 cents = qRound64(number * 100.0);
+            if (double(cents) / 100.0 == number) {
+                out.append(char(CentsTag));
+                writeSigned(out, cents);
+                return;
+            }
+        }
+
+        quint64 bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        char buffer[8];
+        qToLittleEndian(bits, buffer);
+        out.append(char(DoubleTag));
+        out.append(buffer, 8);
+    }
+
+    quint32 intern(const QString &text)
+    {
+        auto it = m_stringIds.constFind(text);
+        if (it != m_stringIds.constEnd())
+            return it.value();
+
+        quint32 id = m_strings.size();
+        m_strings.append(text.toUtf8());
+        m_stringIds.insert(text, id);
+        return id;
+    }
+
+    QHash<QString, quint32> m_stringIds;
+    QList<QByteArray> m_strings;
+};
+
+} // namespace
+
+bool BinaryStore::isBinary(const QByteArray &data)
+{
+    return data.size() >= HeaderSize && std::memcmp(data.constData(), Magic, 4) == 0;
+}
+
+QByteArray BinaryStore::encode(const QJsonArray &array, quint16 flags)
+{
+    Encoder encoder;
+    QByteArray records;
+    QList<quint32> recordOffsets;
+    recordOffsets.reserve(array.size());
+
+    for (const QJsonValue &value : array) {
+        QByteArray payload;
+        encoder.writeValue(payload, value);
+
+        recordOffsets.append(records.size());
+        writeVarint(records, payload.size());
+        records.append(payload);
+    }
+
+    QByteArray strings = encoder.strings();
+    quint32 stringsStart = HeaderSize;
+    quint32 recordsStart = stringsStart + strings.size();
+    quint32 stringIndexOffset = recordsStart + records.size();
+    quint32 recordIndexOffset = stringIndexOffset + (encoder.stringCount() + 1) * 4;
+
+    QByteArray out;
+    out.reserve(recordIndexOffset + recordOffsets.size() * 4);
+
+    out.append(Magic, 4);
+    char version[2];
+    qToLittleEndian(FormatVersion, version);
+    out.append(version, 2);
+    char flagBytes[2];
+    qToLittleEndian(flags, flagBytes);
+    out.append(flagBytes, 2);
+    writeUInt32(out, encoder.stringCount());
+    writeUInt32(out, recordOffsets.size());
+    writeUInt32(out, stringIndexOffset);
+    writeUInt32(out, recordIndexOffset);
+    out.append(HeaderSize - out.size(), '\0');
+
+    out.append(strings);
+    out.append(records);
+
+    for (quint32 offset : encoder.stringOffsets(stringsStart)) {
+        writeUInt32(out, offset);
+    }
+    for (quint32 offset : recordOffsets) {
+        writeUInt32(out, recordsStart + offset);
+    }
+
+    return out;
+}
+
+bool BinaryStore::decode(const QByteArray &data, QJsonArray *array)
+{
+    BinaryStore store(reinterpret_cast<const uchar *>(data.constData()), data.size());
+    if (!store.isValid())
+        return false;
+
+    QJsonArray result;
+    for (int i = 0; i < store.recordCount(); ++i) {
+        bool ok = false;
+        QJsonValue value = store.record(i, &ok);
+        if (!ok)
+            return false;
+        result.append(value);
+    }
+
+    *array = result;
+    return true;
+}
+
+BinaryStore::BinaryStore(const uchar *data, qint64 size)
+    : m_data(data)
+    , m_size(size)
+    , m_valid(false)
+    , m_flags(0)
+    , m_stringCount(0)
+    , m_recordCount(0)
+    , m_stringIndex(nullptr)
+    , m_recordIndex(nullptr)
+{
+    if (!m_data || m_size < HeaderSize || std::memcmp(m_data, Magic, 4) != 0)
+        return;
+
+    if (qFromLittleEndian<quint16>(m_data + 4) > FormatVersion)
+        return;
+
+    quint32 stringCount = qFromLittleEndian<quint32>(m_data + 8);
+    quint32 recordCount = qFromLittleEndian<quint32>(m_data + 12);
+    quint32 stringIndexOffset = qFromLittleEndian<quint32>(m_data + 16);
+    quint32 recordIndexOffset = qFromLittleEndian<quint32>(m_data + 20);
+
+    if (stringIndexOffset + (qint64(stringCount) + 1) * 4 > m_size
+        || recordIndexOffset + qint64(recordCount) * 4 > m_size
+        || recordCount > quint32(std::numeric_limits<int>::max()))
+        return;
+
+    m_flags = qFromLittleEndian<quint16>(m_data + 6);
+    m_stringCount = stringCount;
+    m_recordCount = recordCount;
+    m_stringIndex = m_data + stringIndexOffset;
+    m_recordIndex = m_data + recordIndexOffset;
+    m_valid = true;
+}
+
+QJsonValue BinaryStore::record(int index, bool *ok) const
+{
+    if (ok)
+        *ok = false;
+
+    if (!m_valid || index < 0 || quint32(index) >= m_recordCount)
+        return QJsonValue();
+
+    quint32 offset = qFromLittleEndian<quint32>(m_recordIndex + qint64(index) * 4);
+    if (offset >= m_size)
+        return QJsonValue();
+
+    const uchar *pos = m_data + offset;
+    const uchar *end = m_data + m_size;
+    quint64 length;
+    if (!readVarint(pos, end, &length) || length > quint64(end - pos))
+        return QJsonValue();
+
+    bool valid = false;
+    QJsonValue value = readValue(pos, pos + length, 0, &valid);
+    if (ok)
+        *ok = valid;
+    return value;
+}
+
+QString BinaryStore::string(quint32 index) const
+{
+    if (!m_valid || index >= m_stringCount)
+        return QString();
+
+    quint32 start = qFromLittleEndian<quint32>(m_stringIndex + qint64(index) * 4);
+    quint32 end = qFromLittleEndian<quint32>(m_stringIndex + qint64(index + 1) * 4);
+    if (start > end || end > m_size)
+        return QString();
+
+    return QString::fromUtf8(reinterpret_cast<const char *>(m_data + start), end - start);
+}
+
+QString BinaryStore::key(quint32 index) const
+{
+    // Keys repeat in every record, decode each of them once
+    auto it = m_keyCache.constFind(index);
+    if (it != m_keyCache.constEnd())
+        return it.value();
+
+    QString text = string(index);
+    m_keyCache.insert(index, text);
+    return text;
+}
+
+QJsonValue BinaryStore::readValue(const uchar *&pos, const uchar *end, int depth, bool *ok) const
+{
+    *ok = false;
+    if (pos >= end || depth > MaxDepth)
+        return QJsonValue();
+
+    quint8 tag = *pos++;
+    switch (tag) {
+    case NullTag:
+        *ok = true;
+        return QJsonValue();
+    case FalseTag:
+    case TrueTag:
+        *ok = true;
+        return QJsonValue(tag == TrueTag);
+    case IntegerTag: {
+        qint64 number;
+        if (!readSigned(pos, end, &number))
+            return QJsonValue();
+        *ok = true;
+        return QJsonValue(number);
+    }
+    case CentsTag: {
+        qint64 cents;
+        if (!readSigned(pos, end, &cents))
+            return QJsonValue();
+        *ok = true;
+        return QJsonValue(double(cents) / 100.0);
+    }
+    case DoubleTag: {
+        if (end - pos < 8)
+            return QJsonValue();
+        quint64 bits = qFromLittleEndian<quint64>(pos);
+        pos += 8;
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        *ok = true;
+        return QJsonValue(number);
+    }
+    case StringTag: {
+        quint64 index;
+        if (!readVarint(pos, end, &index) || index >= m_stringCount)
+            return QJsonValue();
+        *ok = true;
+        return QJsonValue(string(quint32(index)));
+    }
+    case DateTag: {
+        qint64 day;
+        if (!readSigned(pos, end, &day))
+            return QJsonValue();
+        *ok = true;
+        return QJsonValue(QDate::fromJulianDay(day + EpochJulianDay).toString(Qt::ISODate));
+    }
+    case ArrayTag: {
+        quint64 count;
+        if (!readVarint(pos, end, &count) || count > quint64(end - pos))
+            return QJsonValue();
+        QJsonArray array;
+        for (quint64 i = 0; i < count; ++i) {
+            QJsonValue item = readValue(pos, end, depth + 1, ok);
+            if (!*ok)
+                return QJsonValue();
+            array.append(item);
+        }
+        *ok = true;
+        return array;
+    }
+    case ObjectTag: {
+        quint64 count;
+        if (!readVarint(pos, end, &count) || count > quint64(end - pos))
+            return QJsonValue();
+        QJsonObject object;
+        for (quint64 i = 0; i < count; ++i) {
+            quint64 keyIndex;
+            if (!readVarint(pos, end, &keyIndex) || keyIndex >= m_stringCount)
+                return QJsonValue();
+            QJsonValue item = readValue(pos, end, depth + 1, ok);
+            if (!*ok)
+                return QJsonValue();
+            object.insert(key(quint32(keyIndex)), item);
+        }
+        *ok = true;
+        return object;
+    }
+    default:
+        return QJsonValue();
+    }
+}
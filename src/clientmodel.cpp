@@ -1,13 +1,28 @@
 #include "clientmodel.h"
 #include <QJsonArray>
 #include <algorithm>
+#include <limits>
+
+// Beyond this many repriced clients one snapshot is cheaper to write and to load than a journal record each
+static const int MaxJournaledReprices = 64;
 
 ClientModel::ClientModel(QObject *parent)
     : BaseModel("clients.json", parent)
     , m_offerModel(nullptr)
     , m_supplementModel(nullptr)
+    , m_nextClientId(0)
+    , m_priceIndexValid(false)
+    , m_clientRowsValid(false)
 {
     m_sortColumn = SortByName;
+
+    // Any structural change shifts rows, the id to row map is rebuilt on next use
+    auto invalidateRows = [this]() { m_clientRowsValid = false; };
+    connect(this, &QAbstractItemModel::rowsInserted, this, invalidateRows);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, invalidateRows);
+    connect(this, &QAbstractItemModel::rowsMoved, this, invalidateRows);
+    connect(this, &QAbstractItemModel::modelReset, this, invalidateRows);
+    connect(this, &QAbstractItemModel::layoutChanged, this, invalidateRows);
 }
 
 void ClientModel::setOfferModel(OfferModel *model)
@@ -43,7 +58,7 @@ QVariant ClientModel::data(const QModelIndex &index, int role) const
     case PriceRole:
         return client.price;
     case SupplementsRole:
-        return QVariant::fromValue(client.supplements);
+        return supplementMap(client.supplements);
     case DiscountRole:
         return client.discount;
     case PhoneNumberRole:
@@ -72,11 +87,47 @@ QHash<int, QByteArray> ClientModel::roleNames() const
     return roles;
 }
 
+QString ClientModel::searchText(int row) const
+{
+    if (row < 0 || row >= m_clients.size())
+        return QString();
+
+    // Price and business type are searched as the client list shows them
+    const Client &client = m_clients.at(row);
+    QStringList fields;
+    fields << client.name
+           << client.phoneNumber
+           << client.comment
+           << QString::number(client.price / 100.0, 'f', 2)
+           << ((client.businessType == 0) ? "Pro" : "Part");
+    return fields.join('\n');
+}
+
+bool ClientModel::filterKey(int row, int role, qint64 *key) const
+{
+    if (row < 0 || row >= m_clients.size())
+        return false;
+
+    if (role == PaymentDateRole) {
+        *key = dayFromString(m_clients.at(row).paymentDate);
+        return true;
+    }
+
+    return BaseModel::filterKey(row, role, key);
+}
+
+qint64 ClientModel::filterKeyFromValue(int role, const QVariant &value) const
+{
+    if (role == PaymentDateRole && value.typeId() == QMetaType::QString)
+        return dayFromString(value.toString());
+
+    return BaseModel::filterKeyFromValue(role, value);
+}
+
 void ClientModel::addClient(int businessType, const QString &name, int offer, int price,
                             const QList<int> &supplements, int discount, const QString &phoneNumber,
                             const QString &paymentDate, const QString &comment)
 {
-    beginInsertRows(QModelIndex(), m_clients.size(), m_clients.size());
     Client client;
     client.businessType = static_cast<BusinessType>(businessType);
     client.name = name;
@@ -84,22 +135,20 @@ void ClientModel::addClient(int businessType, const QString &name, int offer, in
     client.price = price;
 
     for (int suppId : supplements) {
-        client.supplements[suppId] = 1;
+        setSupplementQuantity(client.supplements, suppId, 1);
     }
 
     client.discount = discount;
     client.phoneNumber = phoneNumber;
     client.paymentDate = paymentDate;
     client.comment = comment;
-    m_clients.append(client);
-    endInsertRows();
-
-    beginResetModel();
-    performSort();
-    endResetModel();
+    client.id = m_nextClientId++;
+    indexClient(client, true);
+    updateSortKey(client);
+    int row = insertSorted(m_clients, client, &ClientModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void ClientModel::updateClient(int index, int businessType, const QString &name, int offer, int price,
@@ -109,7 +158,9 @@ void ClientModel::updateClient(int index, int businessType, const QString &name,
     if (index < 0 || index >= m_clients.size())
         return;
 
-    Client &client = m_clients[index];
+    QJsonObject before = entryToJson(index);
+    Client client = m_clients.at(index);
+    indexClient(client, false);
     client.businessType = static_cast<BusinessType>(businessType);
     client.name = name;
     client.offer = static_cast<Offer>(offer);
@@ -117,19 +168,17 @@ void ClientModel::updateClient(int index, int businessType, const QString &name,
 
     client.supplements.clear();
     for (int suppId : supplements) {
-        client.supplements[suppId] = 1;
+        setSupplementQuantity(client.supplements, suppId, 1);
     }
 
     client.discount = discount;
     client.phoneNumber = phoneNumber;
     client.paymentDate = paymentDate;
     client.comment = comment;
-
-    beginResetModel();
-    performSort();
-    endResetModel();
-
-    saveToFile();
+    indexClient(client, true);
+    updateSortKey(client);
+    int row = updateSorted(m_clients, index, client, &ClientModel::lessThan);
+    recordUpdate(before, row);
 }
 
 QJsonObject ClientModel::entryToJson(int index) const
@@ -145,8 +194,10 @@ QJsonObject ClientModel::entryToJson(int index) const
     obj["price"] = client.price;
 
     QJsonObject supplementsObj;
-    for (auto it = client.supplements.begin(); it != client.supplements.end(); ++it) {
-        supplementsObj[QString::number(it.key())] = it.value();
+    for (qsizetype suppId = 0; suppId < client.supplements.size(); ++suppId) {
+        if (client.supplements.at(suppId) > 0) {
+            supplementsObj[QString::number(suppId)] = int(client.supplements.at(suppId));
+        }
     }
     obj["supplements"] = supplementsObj;
 
@@ -168,12 +219,12 @@ void ClientModel::entryFromJson(const QJsonObject &obj)
     if (obj["supplements"].isArray()) {
         QJsonArray supplementsArray = obj["supplements"].toArray();
         for (const QJsonValue &value : supplementsArray) {
-            client.supplements[value.toInt()] = 1;
+            setSupplementQuantity(client.supplements, value.toInt(), 1);
         }
     } else if (obj["supplements"].isObject()) {
         QJsonObject supplementsObj = obj["supplements"].toObject();
         for (auto it = supplementsObj.begin(); it != supplementsObj.end(); ++it) {
-            client.supplements[it.key().toInt()] = it.value().toInt();
+            setSupplementQuantity(client.supplements, it.key().toInt(), it.value().toInt());
         }
     }
 
@@ -181,46 +232,71 @@ void ClientModel::entryFromJson(const QJsonObject &obj)
     client.phoneNumber = obj["phoneNumber"].toString();
     client.paymentDate = obj["paymentDate"].toString();
     client.comment = obj["comment"].toString();
+    client.id = m_nextClientId++;
+    updateSortKey(client);
     m_clients.append(client);
+    m_priceIndexValid = false;
 }
 
 void ClientModel::performSort()
 {
-    std::stable_sort(m_clients.begin(), m_clients.end(), [this](const Client &a, const Client &b) {
-        bool result = false;
-
-        switch (m_sortColumn) {
-        case SortByBusinessType:
-            result = a.businessType < b.businessType;
-            break;
-        case SortByName:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        case SortByOffer:
-            result = a.offer < b.offer;
-            break;
-        case SortByPrice:
-            result = a.price < b.price;
-            break;
-        case SortByDiscount:
-            result = a.discount < b.discount;
-            break;
-        case SortByPhone:
-            result = a.phoneNumber.toLower() < b.phoneNumber.toLower();
-            break;
-        case SortByPaymentDate:
-            result = a.paymentDate.toLower() < b.paymentDate.toLower();
-            break;
-        case SortByComment:
-            result = a.comment.toLower() < b.comment.toLower();
-            break;
-        default:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        }
+    sortRows(m_clients, &ClientModel::lessThan, &ClientModel::updateSortKey);
+}
 
-        return m_sortAscending ? result : !result;
-    });
+bool ClientModel::lessThan(const Client &a, const Client &b) const
+{
+    switch (m_sortColumn) {
+    case SortByBusinessType:
+        return a.businessType < b.businessType;
+    case SortByOffer:
+        return a.offer < b.offer;
+    case SortByPrice:
+        return a.price < b.price;
+    case SortByDiscount:
+        return a.discount < b.discount;
+    default:
+        return a.sortKey < b.sortKey;
+    }
+}
+
+int ClientModel::filterRoleForSortColumn(int column) const
+{
+    switch (column) {
+    case SortByBusinessType:
+        return BusinessTypeRole;
+    case SortByOffer:
+        return OfferRole;
+    case SortByPrice:
+        return PriceRole;
+    case SortByDiscount:
+        return DiscountRole;
+    default:
+        return -1;
+    }
+}
+
+void ClientModel::updateSortKey(Client &client) const
+{
+    switch (m_sortColumn) {
+    case SortByPhone:
+        client.sortKey = client.phoneNumber.toCaseFolded();
+        break;
+    case SortByPaymentDate:
+        client.sortKey = client.paymentDate.toCaseFolded();
+        break;
+    case SortByComment:
+        client.sortKey = client.comment.toCaseFolded();
+        break;
+    case SortByBusinessType:
+    case SortByOffer:
+    case SortByPrice:
+    case SortByDiscount:
+        client.sortKey.clear();
+        break;
+    default:
+        client.sortKey = client.name.toCaseFolded();
+        break;
+    }
 }
 
 void ClientModel::addEntryToModel()
@@ -229,6 +305,8 @@ void ClientModel::addEntryToModel()
 
 void ClientModel::removeEntryFromModel(int index)
 {
+    indexClient(m_clients.at(index), false);
+
     beginRemoveRows(QModelIndex(), index, index);
     m_clients.removeAt(index);
     endRemoveRows();
@@ -237,6 +315,9 @@ void ClientModel::removeEntryFromModel(int index)
 void ClientModel::clearModel()
 {
     m_clients.clear();
+    m_clientsBySupplement.clear();
+    m_clientsByOffer.clear();
+    m_priceIndexValid = true;
 }
 
 int ClientModel::getSupplementCount() const
@@ -286,22 +367,16 @@ void ClientModel::checkout(int clientIndex)
 
 QVariantMap ClientModel::getSupplementQuantities(int clientIndex) const
 {
-    QVariantMap result;
     if (clientIndex < 0 || clientIndex >= m_clients.size())
-        return result;
+        return QVariantMap();
 
-    const Client &client = m_clients.at(clientIndex);
-    for (auto it = client.supplements.begin(); it != client.supplements.end(); ++it) {
-        result[QString::number(it.key())] = it.value();
-    }
-    return result;
+    return supplementMap(m_clients.at(clientIndex).supplements);
 }
 
 void ClientModel::addClientWithQuantities(int businessType, const QString &name, int offer, int price,
                                           const QVariantMap &supplementQuantities, int discount,
                                           const QString &phoneNumber, const QString &paymentDate, const QString &comment)
 {
-    beginInsertRows(QModelIndex(), m_clients.size(), m_clients.size());
     Client client;
     client.businessType = static_cast<BusinessType>(businessType);
     client.name = name;
@@ -311,24 +386,20 @@ void ClientModel::addClientWithQuantities(int businessType, const QString &name,
     for (auto it = supplementQuantities.begin(); it != supplementQuantities.end(); ++it) {
         int suppId = it.key().toInt();
         int quantity = it.value().toInt();
-        if (quantity > 0) {
-            client.supplements[suppId] = quantity;
-        }
+        setSupplementQuantity(client.supplements, suppId, quantity);
     }
 
     client.discount = discount;
     client.phoneNumber = phoneNumber;
     client.paymentDate = paymentDate;
     client.comment = comment;
-    m_clients.append(client);
-    endInsertRows();
-
-    beginResetModel();
-    performSort();
-    endResetModel();
+    client.id = m_nextClientId++;
+    indexClient(client, true);
+    updateSortKey(client);
+    int row = insertSorted(m_clients, client, &ClientModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void ClientModel::updateClientWithQuantities(int index, int businessType, const QString &name, int offer, int price,
@@ -338,7 +409,9 @@ void ClientModel::updateClientWithQuantities(int index, int businessType, const
     if (index < 0 || index >= m_clients.size())
         return;
 
-    Client &client = m_clients[index];
+    QJsonObject before = entryToJson(index);
+    Client client = m_clients.at(index);
+    indexClient(client, false);
     client.businessType = static_cast<BusinessType>(businessType);
     client.name = name;
     client.offer = static_cast<Offer>(offer);
@@ -348,58 +421,256 @@ void ClientModel::updateClientWithQuantities(int index, int businessType, const
     for (auto it = supplementQuantities.begin(); it != supplementQuantities.end(); ++it) {
         int suppId = it.key().toInt();
         int quantity = it.value().toInt();
-        if (quantity > 0) {
-            client.supplements[suppId] = quantity;
-        }
+        setSupplementQuantity(client.supplements, suppId, quantity);
     }
 
     client.discount = discount;
     client.phoneNumber = phoneNumber;
     client.paymentDate = paymentDate;
     client.comment = comment;
+    indexClient(client, true);
+    updateSortKey(client);
+    int row = updateSorted(m_clients, index, client, &ClientModel::lessThan);
+    recordUpdate(before, row);
+}
 
-    beginResetModel();
-    performSort();
-    endResetModel();
+void ClientModel::recalculateAllPrices()
+{
+    if (!m_offerModel || !m_supplementModel) {
+        qWarning() << "Cannot recalculate prices: models not set";
+        return;
+    }
+
+    PricingKernel::PriceTable table = priceTable();
+    int supplementCount = table.supplementPrices.size();
+
+    // Client columns for the batch kernel, supplement quantities column-major
+    PricingKernel::Columns columns;
+    columns.count = m_clients.size();
+    columns.offers.reserve(columns.count);
+    columns.discounts.reserve(columns.count);
+    columns.quantities.fill(0, qsizetype(supplementCount) * columns.count);
+    for (int i = 0; i < columns.count; ++i) {
+        const Client &client = m_clients.at(i);
+        columns.offers.append(client.offer);
+        columns.discounts.append(client.discount);
+
+        int held = qMin(int(client.supplements.size()), supplementCount);
+        for (int suppId = 0; suppId < held; ++suppId) {
+            columns.quantities[qsizetype(suppId) * columns.count + i] = client.supplements.at(suppId);
+        }
+    }
+
+    QList<int> prices = PricingKernel::price(table, columns);
+
+    int firstChanged = -1;
+    int lastChanged = -1;
+    for (int i = 0; i < columns.count; ++i) {
+        if (m_clients.at(i).price != prices.at(i)) {
+            m_clients[i].price = prices.at(i);
+            if (firstChanged < 0) {
+                firstChanged = i;
+            }
+            lastChanged = i;
+        }
+    }
 
-    saveToFile();
+    if (firstChanged >= 0) {
+        // Sorted by price, the new prices move rows; sorted edits and range filters expect them in order
+        if (m_sortColumn == SortByPrice) {
+            resort();
+        } else {
+            emit dataChanged(index(firstChanged, 0), index(lastChanged, 0), {PriceRole});
+        }
+        saveToFile();
+    }
 }
 
-void ClientModel::recalculateAllPrices()
+PricingKernel::PriceTable ClientModel::priceTable() const
+{
+    PricingKernel::PriceTable table;
+
+    int offerCount = m_offerModel->rowCount();
+    table.offerPrices.reserve(offerCount);
+    for (int id = 0; id < offerCount; ++id) {
+        table.offerPrices.append(m_offerModel->getOfferPrice(id));
+    }
+
+    int supplementCount = m_supplementModel->rowCount();
+    table.supplementPrices.reserve(supplementCount);
+    for (int id = 0; id < supplementCount; ++id) {
+        table.supplementPrices.append(m_supplementModel->getSupplementPrice(id));
+    }
+    return table;
+}
+
+void ClientModel::recalculateSupplementPrices(int firstId, int lastId)
+{
+    ensurePriceIndex();
+
+    QSet<quint32> affected;
+    for (int id = firstId; id <= lastId; ++id) {
+        affected.unite(m_clientsBySupplement.value(id));
+    }
+    recalculatePrices(affected);
+}
+
+void ClientModel::recalculateOfferPrices(int firstId, int lastId)
+{
+    ensurePriceIndex();
+
+    QSet<quint32> affected;
+    for (int id = firstId; id <= lastId; ++id) {
+        affected.unite(m_clientsByOffer.value(id));
+    }
+    recalculatePrices(affected);
+}
+
+void ClientModel::setSupplementQuantity(SupplementQuantities &quantities, int suppId, int quantity)
+{
+    if (suppId < 0 || suppId > std::numeric_limits<quint16>::max())
+        return;
+
+    quantity = qBound(0, quantity, int(std::numeric_limits<quint16>::max()));
+    if (suppId >= quantities.size()) {
+        if (quantity == 0)
+            return;
+        quantities.resize(suppId + 1, 0);
+    }
+    quantities[suppId] = quint16(quantity);
+}
+
+QVariantMap ClientModel::supplementMap(const SupplementQuantities &quantities)
+{
+    QVariantMap result;
+    for (qsizetype suppId = 0; suppId < quantities.size(); ++suppId) {
+        if (quantities.at(suppId) > 0) {
+            result[QString::number(suppId)] = int(quantities.at(suppId));
+        }
+    }
+    return result;
+}
+
+int ClientModel::priceFor(const Client &client) const
+{
+    int basePrice = 0;
+    if (client.offer >= 0 && client.offer < m_offerModel->rowCount()) {
+        basePrice = m_offerModel->getOfferPrice(client.offer);
+    }
+
+    int supplementsTotal = 0;
+    int supplementCount = qMin(int(client.supplements.size()), m_supplementModel->rowCount());
+    for (int suppId = 0; suppId < supplementCount; ++suppId) {
+        int quantity = client.supplements.at(suppId);
+        if (quantity > 0) {
+            supplementsTotal += m_supplementModel->getSupplementPrice(suppId) * quantity;
+        }
+    }
+
+    int totalBeforeDiscount = basePrice + supplementsTotal;
+    return totalBeforeDiscount * (100 - client.discount) / 100;
+}
+
+void ClientModel::recalculatePrices(const QSet<quint32> &clientIds)
 {
     if (!m_offerModel || !m_supplementModel) {
         qWarning() << "Cannot recalculate prices: models not set";
         return;
     }
 
-    for (int i = 0; i < m_clients.size(); ++i) {
-        Client &client = m_clients[i];
+    // Prices are updated in place like a full recalculation
+    QList<QPair<quint32, QJsonObject>> changed;
+    for (quint32 id : clientIds) {
+        int row = rowOfClient(id);
+        if (row < 0)
+            continue;
 
-        int basePrice = 0;
-        if (client.offer >= 0 && client.offer < m_offerModel->rowCount()) {
-            basePrice = m_offerModel->getOfferPrice(client.offer);
+        int newPrice = priceFor(m_clients.at(row));
+        if (m_clients.at(row).price == newPrice)
+            continue;
+
+        changed.append({id, entryToJson(row)});
+        m_clients[row].price = newPrice;
+    }
+
+    if (changed.isEmpty())
+        return;
+
+    // Sorted by price, the new prices move rows; sorted edits and range filters expect them in order
+    if (m_sortColumn == SortByPrice) {
+        resort();
+    } else {
+        for (const auto &client : std::as_const(changed)) {
+            QModelIndex idx = index(rowOfClient(client.first), 0);
+            emit dataChanged(idx, idx, {PriceRole});
         }
+    }
+
+    // A few changed clients are journaled on their own, a large batch rewrites the file once
+    if (changed.size() > MaxJournaledReprices) {
+        saveToFile();
+        return;
+    }
 
-        int supplementsTotal = 0;
-        for (auto it = client.supplements.begin(); it != client.supplements.end(); ++it) {
-            int suppId = it.key();
-            int quantity = it.value();
-            if (suppId >= 0 && suppId < m_supplementModel->rowCount()) {
-                supplementsTotal += m_supplementModel->getSupplementPrice(suppId) * quantity;
+    for (const auto &client : std::as_const(changed)) {
+        recordUpdate(client.second, rowOfClient(client.first));
+    }
+}
+
+void ClientModel::indexClient(const Client &client, bool add)
+{
+    if (!m_priceIndexValid)
+        return;
+
+    auto update = [&client, add](QHash<int, QSet<quint32>> &index, int key) {
+        if (add) {
+            index[key].insert(client.id);
+            return;
+        }
+
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->remove(client.id);
+            if (it->isEmpty()) {
+                index.erase(it);
             }
         }
+    };
 
-        int totalBeforeDiscount = basePrice + supplementsTotal;
-        int newPrice = totalBeforeDiscount * (100 - client.discount) / 100;
+    update(m_clientsByOffer, client.offer);
+    for (qsizetype suppId = 0; suppId < client.supplements.size(); ++suppId) {
+        if (client.supplements.at(suppId) > 0) {
+            update(m_clientsBySupplement, suppId);
+        }
+    }
+}
 
-        if (client.price != newPrice) {
-            client.price = newPrice;
-            QModelIndex idx = index(i, 0);
-            emit dataChanged(idx, idx, {PriceRole});
+void ClientModel::ensurePriceIndex()
+{
+    if (m_priceIndexValid)
+        return;
+
+    m_clientsBySupplement.clear();
+    m_clientsByOffer.clear();
+    m_priceIndexValid = true;
+
+    for (const Client &client : std::as_const(m_clients)) {
+        indexClient(client, true);
+    }
+}
+
+int ClientModel::rowOfClient(quint32 id) const
+{
+    if (!m_clientRowsValid) {
+        m_clientRows.clear();
+        m_clientRows.reserve(m_clients.size());
+        for (int row = 0; row < m_clients.size(); ++row) {
+            m_clientRows.insert(m_clients.at(row).id, row);
         }
+        m_clientRowsValid = true;
     }
 
-    saveToFile();
+    return m_clientRows.value(id, -1);
 }
 
 void ClientModel::updateComment(int row, const QString &comment)
@@ -409,6 +680,7 @@ void ClientModel::updateComment(int row, const QString &comment)
     }
 
     m_clients[row].comment = comment;
+    updateSortKey(m_clients[row]);
 
     QModelIndex index = this->index(row, 0);
     emit dataChanged(index, index, {CommentRole});
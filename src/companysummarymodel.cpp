@@ -26,17 +26,18 @@ QHash<int, QByteArray> CompanySummaryModel::roleNames() const
     return QHash<int, QByteArray>();
 }
 
-int CompanySummaryModel::money() const
+double CompanySummaryModel::money() const
 {
-    return m_money;
+    return fromCents(m_money);
 }
 
-void CompanySummaryModel::setMoney(int money)
+void CompanySummaryModel::setMoney(qint64 money)
 {
     if (m_money != money) {
+        QJsonObject before = entryToJson(0);
         m_money = money;
         emit moneyChanged();
-        saveToFile();
+        recordUpdate(before, 0);
     }
 }
 
@@ -48,34 +49,35 @@ QString CompanySummaryModel::companyName() const
 void CompanySummaryModel::setCompanyName(const QString &name)
 {
     if (m_companyName != name) {
+        QJsonObject before = entryToJson(0);
         m_companyName = name;
         emit companyNameChanged();
-        saveToFile();
+        recordUpdate(before, 0);
     }
 }
 
-void CompanySummaryModel::addToMoney(int amount)
+void CompanySummaryModel::addToMoney(double amount)
 {
-    setMoney(m_money + amount);
+    setMoney(m_money + toCents(amount));
 }
 
-void CompanySummaryModel::subtractFromMoney(int amount)
+void CompanySummaryModel::subtractFromMoney(double amount)
 {
-    setMoney(m_money - amount);
+    setMoney(m_money - toCents(amount));
 }
 
 QJsonObject CompanySummaryModel::entryToJson(int index) const
 {
     Q_UNUSED(index)
     QJsonObject obj;
-    obj["money"] = m_money;
+    obj["money"] = fromCents(m_money);
     obj["companyName"] = m_companyName;
     return obj;
 }
 
 void CompanySummaryModel::entryFromJson(const QJsonObject &obj)
 {
-    m_money = obj["money"].toInt(0);
+    m_money = toCents(obj["money"].toDouble(0));
     m_companyName = obj["companyName"].toString("");
 
     emit moneyChanged();
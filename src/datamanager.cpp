@@ -9,6 +9,8 @@
 #include <QDebug>
 #include <QCryptographicHash>
 #include <QDateTime>
+#include <QCoreApplication>
+#include <QPointer>
 
 DataManager* DataManager::m_instance = nullptr;
 
@@ -41,7 +43,7 @@ DataManager* DataManager::instance()
     return m_instance;
 }
 
-bool DataManager::exportData(const QString &filePath,
+void DataManager::exportData(const QString &filePath,
                              EmployeeModel *employeeModel,
                              TransactionModel *transactionModel,
                              AwaitingTransactionModel *awaitingTransactionModel,
@@ -53,14 +55,19 @@ bool DataManager::exportData(const QString &filePath,
 {
     if (filePath.isEmpty()) {
         emit exportCompleted(false, "File path is empty");
-        return false;
+        return;
     }
 
-    try {
-        QJsonObject rootObject = collectAllData(employeeModel, transactionModel,
-                                                awaitingTransactionModel, clientModel,
-                                                supplementModel, offerModel,
-                                                companySummaryModel, noteModel);
+    QJsonObject rootObject = collectAllData(employeeModel, transactionModel,
+                                            awaitingTransactionModel, clientModel,
+                                            supplementModel, offerModel,
+                                            companySummaryModel, noteModel);
+
+    // Serialization and the disk write run on the storage thread, the result comes back queued
+    QPointer<DataManager> self(this);
+    BaseModel::storageThreadPool()->start([self, filePath, rootObject]() {
+        bool success = false;
+        QString message;
 
         QJsonDocument doc(rootObject);
         QByteArray jsonData = doc.toJson(QJsonDocument::Compact);
@@ -70,25 +77,22 @@ bool DataManager::exportData(const QString &filePath,
 
         QFile file(filePath);
         if (!file.open(QIODevice::WriteOnly)) {
-            emit exportCompleted(false, "Could not open file for writing: " + file.errorString());
-            return false;
-        }
-
-        qint64 bytesWritten = file.write(jsonData);
-        file.close();
+            message = "Could not open file for writing: " + file.errorString();
+        } else {
+            qint64 bytesWritten = file.write(jsonData);
+            file.close();
 
-        if (bytesWritten == -1) {
-            emit exportCompleted(false, "Failed to write data to file");
-            return false;
+            success = bytesWritten == jsonData.size();
+            message = success ? "Data exported successfully to " + filePath
+                              : QString("Failed to write data to file");
         }
 
-        emit exportCompleted(true, "Data exported successfully to " + filePath);
-        return true;
-
-    } catch (const std::exception &e) {
-        emit exportCompleted(false, "Export failed: " + QString::fromStdString(e.what()));
-        return false;
-    }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, success, message]() {
+            if (self) {
+                emit self->exportCompleted(success, message);
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
 bool DataManager::importData(const QString &filePath,
@@ -357,7 +361,7 @@ QJsonArray DataManager::modelToJsonArray(BaseModel *model)
         return array;
     }
 
-    for (int i = 0; i < model->rowCount(); ++i) {
+    for (int i = 0; i < model->entryCount(); ++i) {
         QJsonObject entry = model->entryToJson(i);
         if (!entry.isEmpty()) {
             array.append(entry);
@@ -382,6 +386,8 @@ bool DataManager::restoreModelFromJsonArray(BaseModel *model, const QJsonArray &
             model->entryFromJson(obj);
         }
 
+        // Sorted edits and the snapshot's sort flags both rely on the rows being in order
+        model->performSort();
         model->endResetModel();
         model->saveToFile();
         return true;
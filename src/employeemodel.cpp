@@ -50,19 +50,36 @@ QHash<int, QByteArray> EmployeeModel::roleNames() const
     return roles;
 }
 
+bool EmployeeModel::filterKey(int row, int role, qint64 *key) const
+{
+    if (row < 0 || row >= m_employees.size())
+        return false;
+
+    if (role == AddedDateRole) {
+        *key = dayFromString(m_employees.at(row).addedDate);
+        return true;
+    }
+
+    return BaseModel::filterKey(row, role, key);
+}
+
+qint64 EmployeeModel::filterKeyFromValue(int role, const QVariant &value) const
+{
+    if (role == AddedDateRole && value.typeId() == QMetaType::QString)
+        return dayFromString(value.toString());
+
+    return BaseModel::filterKeyFromValue(role, value);
+}
+
 void EmployeeModel::addEmployee(const QString &name, const QString &phone,
                                 const QString &role, int salary, const QString &addedDate, const QString &comment)
 {
-    beginInsertRows(QModelIndex(), m_employees.size(), m_employees.size());
-    m_employees.append({name, phone, role, salary, addedDate, comment});
-    endInsertRows();
-
-    beginResetModel();
-    performSort();
-    endResetModel();
+    Employee employee{name, phone, role, salary, addedDate, comment};
+    updateSortKey(employee);
+    int row = insertSorted(m_employees, employee, &EmployeeModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void EmployeeModel::updateEmployee(int index, const QString &name, const QString &phone,
@@ -71,13 +88,11 @@ void EmployeeModel::updateEmployee(int index, const QString &name, const QString
     if (index < 0 || index >= m_employees.size())
         return;
 
-    m_employees[index] = {name, phone, role, salary, addedDate, comment};
-
-    beginResetModel();
-    performSort();
-    endResetModel();
-
-    saveToFile();
+    QJsonObject before = entryToJson(index);
+    Employee employee{name, phone, role, salary, addedDate, comment};
+    updateSortKey(employee);
+    int row = updateSorted(m_employees, index, employee, &EmployeeModel::lessThan);
+    recordUpdate(before, row);
 }
 
 void EmployeeModel::payEmployee(int employeeIndex)
@@ -93,35 +108,51 @@ void EmployeeModel::payEmployee(int employeeIndex)
 
 void EmployeeModel::performSort()
 {
-    std::stable_sort(m_employees.begin(), m_employees.end(), [this](const Employee &a, const Employee &b) {
-        bool result = false;
-
-        switch (m_sortColumn) {
-        case SortByName:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        case SortByPhone:
-            result = a.phone < b.phone;
-            break;
-        case SortByRole:
-            result = a.role.toLower() < b.role.toLower();
-            break;
-        case SortBySalary:
-            result = a.salary < b.salary;
-            break;
-        case SortByAddedDate:
-            result = a.addedDate < b.addedDate;
-            break;
-        case SortByComment:
-            result = a.comment.toLower() < b.comment.toLower();
-            break;
-        default:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        }
-
-        return m_sortAscending ? result : !result;
-    });
+    sortRows(m_employees, &EmployeeModel::lessThan, &EmployeeModel::updateSortKey);
+}
+
+bool EmployeeModel::lessThan(const Employee &a, const Employee &b) const
+{
+    switch (m_sortColumn) {
+    case SortByPhone:
+        return a.phone < b.phone;
+    case SortBySalary:
+        return a.salary < b.salary;
+    case SortByAddedDate:
+        return a.addedDate < b.addedDate;
+    default:
+        return a.sortKey < b.sortKey;
+    }
+}
+
+int EmployeeModel::filterRoleForSortColumn(int column) const
+{
+    switch (column) {
+    case SortBySalary:
+        return SalaryRole;
+    default:
+        return -1;
+    }
+}
+
+void EmployeeModel::updateSortKey(Employee &employee) const
+{
+    switch (m_sortColumn) {
+    case SortByRole:
+        employee.sortKey = employee.role.toCaseFolded();
+        break;
+    case SortByComment:
+        employee.sortKey = employee.comment.toCaseFolded();
+        break;
+    case SortByPhone:
+    case SortBySalary:
+    case SortByAddedDate:
+        employee.sortKey.clear();
+        break;
+    default:
+        employee.sortKey = employee.name.toCaseFolded();
+        break;
+    }
 }
 
 QJsonObject EmployeeModel::entryToJson(int index) const
@@ -149,6 +180,7 @@ void EmployeeModel::entryFromJson(const QJsonObject &obj)
     emp.salary = obj["salary"].toInt();
     emp.addedDate = obj["addedDate"].toString();
     emp.comment = obj["comment"].toString();
+    updateSortKey(emp);
     m_employees.append(emp);
 }
 
@@ -1,15 +1,30 @@
 #include "filterproxymodel.h"
-#include "employeemodel.h"
-#include "transactionmodel.h"
-#include "awaitingtransactionmodel.h"
-#include "clientmodel.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThreadPool>
+#include <limits>
+
+// Below this many rows a search is cheaper than handing it to a worker thread
+static const int AsyncRowThreshold = 10000;
 
 FilterProxyModel::FilterProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
+    , m_generation(new QAtomicInt(0))
+    , m_searching(false)
+    , m_windowValid(false)
+    , m_windowFilter(-1)
+    , m_windowFirst(0)
+    , m_windowLast(-1)
 {
     setFilterCaseSensitivity(Qt::CaseInsensitive);
 }
 
+FilterProxyModel::~FilterProxyModel()
+{
+    // Lets a search still running on a worker stop at its next chunk
+    m_generation->fetchAndAddOrdered(1);
+}
+
 QString FilterProxyModel::filterText() const
 {
     return m_filterText;
@@ -19,84 +34,324 @@ void FilterProxyModel::setFilterText(const QString &text)
 {
     if (m_filterText != text) {
         m_filterText = text;
-        invalidateFilter();
+        m_foldedFilter = text.toCaseFolded();
+        fetchAllWhileFiltering();
+        updateMatches();
         emit filterTextChanged();
     }
 }
 
 void FilterProxyModel::setSourceModel(QAbstractItemModel *model)
 {
+    delete m_index;
+    m_baseModel = qobject_cast<BaseModel*>(model);
+
+    // The index has to see source changes before the proxy re-filters the affected rows
+    if (m_baseModel) {
+        BaseModel *baseModel = m_baseModel;
+        m_index = new SearchIndex(model, [baseModel](int row) { return baseModel->searchText(row); }, this);
+        connect(m_index, &SearchIndex::rebuilt, this, &FilterProxyModel::resetMatches);
+        connect(m_index, &SearchIndex::updated, this, [this]() { m_windowValid = false; });
+    }
+    resetMatches();
+    compileColumnFilters();
+
     QSortFilterProxyModel::setSourceModel(model);
     emit sourceModelChanged();
 }
 
 bool FilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
-    if (m_filterText.isEmpty()) {
+    Q_UNUSED(sourceParent)
+
+    if (!acceptsColumns(sourceRow)) {
+        return false;
+    }
+
+    if (m_appliedText.isEmpty()) {
         return true;
     }
 
-    QAbstractItemModel *model = sourceModel();
-    if (!model) {
+    if (!m_index || sourceRow >= m_index->rowCount()) {
         return false;
     }
 
-    QModelIndex index = model->index(sourceRow, 0, sourceParent);
+    quint32 id = m_index->rowId(sourceRow);
+    if (m_results.isEmpty() || id >= m_results.last().searchedUpTo) {
+        return m_index->text(id).contains(m_appliedText);
+    }
+
+    const SearchResult &result = m_results.last();
+    return std::binary_search(result.matches.begin(), result.matches.end(), id);
+}
+
+void FilterProxyModel::setRangeFilter(const QString &roleName, const QVariant &minimum, const QVariant &maximum)
+{
+    m_columnFilterSpecs.insert(roleName, {minimum, maximum});
+    compileColumnFilters();
+    fetchAllWhileFiltering();
+    invalidateRowsFilter();
+    emit columnFiltersChanged();
+}
+
+void FilterProxyModel::setValueFilter(const QString &roleName, const QVariant &value)
+{
+    setRangeFilter(roleName, value, value);
+}
+
+void FilterProxyModel::removeColumnFilter(const QString &roleName)
+{
+    if (m_columnFilterSpecs.remove(roleName) == 0)
+        return;
+
+    compileColumnFilters();
+    fetchAllWhileFiltering();
+    invalidateRowsFilter();
+    emit columnFiltersChanged();
+}
+
+void FilterProxyModel::clearColumnFilters()
+{
+    if (m_columnFilterSpecs.isEmpty())
+        return;
+
+    m_columnFilterSpecs.clear();
+    compileColumnFilters();
+    fetchAllWhileFiltering();
+    invalidateRowsFilter();
+    emit columnFiltersChanged();
+}
+
+void FilterProxyModel::updateMatches()
+{
+    // Whatever is still running was started for an older text
+    int generation = m_generation->fetchAndAddOrdered(1) + 1;
+
+    if (!m_index || m_foldedFilter.isEmpty()) {
+        SearchResult none;
+        publish(none);
+        return;
+    }
+
+    // The longest cached text the new one still contains
+    qsizetype base = m_results.size() - 1;
+    while (base >= 0 && !m_foldedFilter.contains(m_results.at(base).text)) {
+        --base;
+    }
+
+    // Characters were deleted back to a cached text. Row ids are never reused,
+    // so the cached matches are still exact for every row indexed back then.
+    if (base >= 0 && m_results.at(base).text == m_foldedFilter) {
+        SearchResult cached = m_results.at(base);
+        publish(cached);
+        return;
+    }
+
+    SearchResult result;
+    result.text = m_foldedFilter;
+    result.searchedUpTo = m_index->nextId();
+
+    // Only rows matching a substring of the new text can match it
+    QList<quint32> candidates;
+    quint32 since = 0;
+    bool refining = base >= 0;
+    if (refining) {
+        candidates = m_results.at(base).matches;
+        since = m_results.at(base).searchedUpTo;
+    }
+
+    if (m_index->rowCount() < AsyncRowThreshold) {
+        result.matches = refining ? m_index->refine(m_foldedFilter, candidates, since)
+                                  : m_index->search(m_foldedFilter);
+        publish(result);
+        return;
+    }
+
+    // Search a snapshot of the index on a worker; the rows keep showing the
+    // previous result until this one is published in a single step
+    setSearching(true);
+
+    SearchIndex::Snapshot snapshot = m_index->snapshot();
+    QSharedPointer<QAtomicInt> current = m_generation;
+    QPointer<FilterProxyModel> self(this);
+    QThreadPool::globalInstance()->start([self, snapshot, result, candidates, since, refining, current, generation]() mutable {
+        auto cancelled = [current, generation]() { return current->loadAcquire() != generation; };
+
+        result.matches = refining ? SearchIndex::refine(snapshot, result.text, candidates, since, cancelled)
+                                  : SearchIndex::search(snapshot, result.text, cancelled);
+        if (cancelled())
+            return;
 
-    // Check if this is an EmployeeModel
-    if (qobject_cast<EmployeeModel*>(model)) {
-        QString name = model->data(index, EmployeeModel::NameRole).toString();
-        QString phone = model->data(index, EmployeeModel::PhoneRole).toString();
-        QString role = model->data(index, EmployeeModel::RoleRole).toString();
-        QString salary = QString::number(model->data(index, EmployeeModel::SalaryRole).toInt());
-        QString addedDate = model->data(index, EmployeeModel::AddedDateRole).toString();
-        QString comment = model->data(index, EmployeeModel::CommentRole).toString();
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, result, current, generation]() {
+            if (self && current->loadAcquire() == generation) {
+                self->publish(result);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void FilterProxyModel::resetMatches()
+{
+    // Rows indexed by the rebuild all have new ids, the applied text keeps
+    // being tested directly until the fresh search is published
+    m_results.clear();
+    updateMatches();
 
-        return matchesFilter(name) || matchesFilter(phone) || matchesFilter(role) ||
-               matchesFilter(salary) || matchesFilter(addedDate) || matchesFilter(comment);
+    // A reset pages the source back to its first rows; fetching from inside
+    // its modelReset would reach the views before the reset itself
+    QMetaObject::invokeMethod(this, &FilterProxyModel::fetchAllWhileFiltering, Qt::QueuedConnection);
+}
+
+void FilterProxyModel::fetchAllWhileFiltering()
+{
+    // A filter has to see every entry, not just the rows a view scrolled to
+    if (m_baseModel && (!m_filterText.isEmpty() || !m_columnFilters.isEmpty())) {
+        m_baseModel->fetchAll();
     }
+}
 
-    // Check if this is a TransactionModel
-    if (qobject_cast<TransactionModel*>(model)) {
-        QString description = model->data(index, TransactionModel::DescriptionRole).toString();
-        QString amount = QString::number(model->data(index, TransactionModel::AmountRole).toDouble());
-        QString date = model->data(index, TransactionModel::DateRole).toString();
+void FilterProxyModel::publish(const SearchResult &result)
+{
+    // A new result for the applied text accepts exactly the same rows, so the
+    // proxy only re-filters when the text changed
+    bool changed = m_appliedText != result.text;
 
-        return matchesFilter(description) || matchesFilter(amount) || matchesFilter(date);
+    if (!result.text.isEmpty()) {
+        while (!m_results.isEmpty() && !result.text.contains(m_results.last().text)) {
+            m_results.removeLast();
+        }
+        if (m_results.isEmpty() || m_results.last().text != result.text) {
+            m_results.append(result);
+        }
     }
 
-    // Check if this is an AwaitingTransactionModel
-    if (qobject_cast<AwaitingTransactionModel*>(model)) {
-        QString description = model->data(index, AwaitingTransactionModel::DescriptionRole).toString();
-        QString amount = QString::number(model->data(index, AwaitingTransactionModel::AmountRole).toDouble());
-        QString date = model->data(index, AwaitingTransactionModel::DateRole).toString();
+    m_appliedText = result.text;
+    if (changed) {
+        invalidateRowsFilter();
+    }
+    setSearching(false);
+}
 
-        return matchesFilter(description) || matchesFilter(amount) || matchesFilter(date);
+void FilterProxyModel::setSearching(bool searching)
+{
+    if (m_searching != searching) {
+        m_searching = searching;
+        emit searchingChanged();
     }
+}
 
-    // Check if this is a ClientModel
-    if (qobject_cast<ClientModel*>(model)) {
-        QString name = model->data(index, ClientModel::NameRole).toString();
-        QString phone = model->data(index, ClientModel::PhoneNumberRole).toString();
-        QString paymentDate = model->data(index, ClientModel::PaymentDateRole).toString();
-        QString comment = model->data(index, ClientModel::CommentRole).toString();
+void FilterProxyModel::compileColumnFilters()
+{
+    m_columnFilters.clear();
+    m_windowValid = false;
 
-        // Format price as display string
-        double priceValue = model->data(index, ClientModel::PriceRole).toDouble();
-        QString price = QString::number(priceValue / 100.0, 'f', 2);
+    if (!m_baseModel) {
+        return;
+    }
 
-        // Format business type
-        int businessTypeValue = model->data(index, ClientModel::BusinessTypeRole).toInt();
-        QString businessType = (businessTypeValue == 0) ? "Pro" : "Part";
+    // Role names and bounds are resolved once, rows are then compared as integers
+    QHash<int, QByteArray> roles = m_baseModel->roleNames();
+    for (auto it = m_columnFilterSpecs.begin(); it != m_columnFilterSpecs.end(); ++it) {
+        int role = roles.key(it.key().toUtf8(), -1);
+        if (role < 0) {
+            qWarning() << "Ignoring filter on unknown role" << it.key();
+            continue;
+        }
 
-        return matchesFilter(name) || matchesFilter(phone) || matchesFilter(comment) ||
-               matchesFilter(price) || matchesFilter(businessType);
+        const ColumnFilterSpec &spec = it.value();
+        ColumnFilter filter;
+        filter.role = role;
+        filter.minimum = spec.minimum.isNull() ? std::numeric_limits<qint64>::min()
+                                               : m_baseModel->filterKeyFromValue(role, spec.minimum);
+        filter.maximum = spec.maximum.isNull() ? std::numeric_limits<qint64>::max()
+                                               : m_baseModel->filterKeyFromValue(role, spec.maximum);
+        m_columnFilters.append(filter);
     }
+}
 
-    return false;
+bool FilterProxyModel::acceptsColumns(int sourceRow) const
+{
+    if (m_columnFilters.isEmpty()) {
+        return true;
+    }
+
+    if (!m_baseModel) {
+        return false;
+    }
+
+    if (!m_windowValid) {
+        updateWindow();
+    }
+
+    if (m_windowFilter >= 0 && (sourceRow < m_windowFirst || sourceRow > m_windowLast)) {
+        return false;
+    }
+
+    for (int i = 0; i < m_columnFilters.size(); ++i) {
+        if (i == m_windowFilter)
+            continue;
+
+        const ColumnFilter &filter = m_columnFilters.at(i);
+        qint64 key = 0;
+        if (!m_baseModel->filterKey(sourceRow, filter.role, &key)) {
+            return false;
+        }
+        if (key < filter.minimum || key > filter.maximum) {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool FilterProxyModel::matchesFilter(const QString &text) const
+void FilterProxyModel::updateWindow() const
 {
-    return text.contains(m_filterText, Qt::CaseInsensitive);
+    m_windowValid = true;
+    m_windowFilter = -1;
+
+    int role = m_baseModel->sortedFilterRole();
+    if (role < 0) {
+        return;
+    }
+
+    for (int i = 0; i < m_columnFilters.size() && m_windowFilter < 0; ++i) {
+        if (m_columnFilters.at(i).role == role) {
+            m_windowFilter = i;
+        }
+    }
+    if (m_windowFilter < 0) {
+        return;
+    }
+
+    const ColumnFilter &filter = m_columnFilters.at(m_windowFilter);
+    BaseModel *model = m_baseModel;
+    auto keyAt = [model, role](int row) {
+        qint64 key = 0;
+        model->filterKey(row, role, &key);
+        return key;
+    };
+
+    // First row for which before() no longer holds
+    auto partitionPoint = [model, &keyAt](auto before) {
+        int low = 0;
+        int high = model->rowCount();
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            if (before(keyAt(middle))) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    };
+
+    int end;
+    if (model->sortAscending()) {
+        m_windowFirst = partitionPoint([&filter](qint64 key) { return key < filter.minimum; });
+        end = partitionPoint([&filter](qint64 key) { return key <= filter.maximum; });
+    } else {
+        m_windowFirst = partitionPoint([&filter](qint64 key) { return key > filter.maximum; });
+        end = partitionPoint([&filter](qint64 key) { return key >= filter.minimum; });
+    }
+    m_windowLast = end - 1;
 }
@@ -0,0 +1,178 @@
+#include "ledgeranalytics.h"
+#include <QDate>
+
+static int monthKey(const QDate &date)
+{
+    return date.year() * 12 + date.month() - 1;
+}
+
+LedgerAnalytics::LedgerAnalytics(QObject *parent)
+    : QObject(parent)
+    , m_weekCount(12)
+    , m_monthCount(12)
+{
+}
+
+void LedgerAnalytics::setTransactionModel(TransactionModel *model)
+{
+    if (m_model == model)
+        return;
+
+    if (m_model) {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+
+    m_model = model;
+
+    if (m_model) {
+        connect(m_model, &TransactionModel::transactionInserted, this, &LedgerAnalytics::onTransactionInserted);
+        connect(m_model, &TransactionModel::transactionRemoved, this, &LedgerAnalytics::onTransactionRemoved);
+        connect(m_model, &QAbstractItemModel::modelReset, this, &LedgerAnalytics::rebuild);
+    }
+
+    emit transactionModelChanged();
+    rebuild();
+}
+
+void LedgerAnalytics::setWeekCount(int count)
+{
+    count = qMax(1, count);
+    if (m_weekCount == count)
+        return;
+
+    m_weekCount = count;
+    emit weekCountChanged();
+    emit totalsChanged();
+}
+
+void LedgerAnalytics::setMonthCount(int count)
+{
+    count = qMax(1, count);
+    if (m_monthCount == count)
+        return;
+
+    m_monthCount = count;
+    emit monthCountChanged();
+    emit totalsChanged();
+}
+
+QVariantList LedgerAnalytics::weeklyTotals() const
+{
+    // Julian day 0 is a Monday, so every week starts on a multiple of 7
+    qint64 today = QDate::currentDate().toJulianDay();
+    qint64 firstMonday = today - today % 7 - qint64(m_weekCount - 1) * 7;
+
+    QVariantList weeks;
+    weeks.reserve(m_weekCount);
+    for (int i = 0; i < m_weekCount; ++i) {
+        qint64 monday = firstMonday + qint64(i) * 7;
+        QDate date = QDate::fromJulianDay(monday);
+
+        QVariantMap week;
+        week["monday"] = date.toString(Qt::ISODate);
+        week["label"] = date.toString("MMM d");
+        week["total"] = BaseModel::fromCents(m_weeks.value(monday));
+        weeks.append(week);
+    }
+    return weeks;
+}
+
+QVariantList LedgerAnalytics::monthlyTotals() const
+{
+    QDate firstMonth = QDate::currentDate().addMonths(-(m_monthCount - 1));
+    firstMonth.setDate(firstMonth.year(), firstMonth.month(), 1);
+
+    QVariantList months;
+    months.reserve(m_monthCount);
+    for (int i = 0; i < m_monthCount; ++i) {
+        QDate date = firstMonth.addMonths(i);
+
+        QVariantMap month;
+        month["month"] = date.toString("yyyy-MM");
+        month["label"] = date.toString("MMM yyyy");
+        month["total"] = BaseModel::fromCents(m_months.value(monthKey(date)));
+        months.append(month);
+    }
+    return months;
+}
+
+QVariant LedgerAnalytics::lastTransaction() const
+{
+    if (m_latest.day <= 0)
+        return QVariant();
+
+    QVariantMap transaction;
+    transaction["description"] = m_latest.description;
+    transaction["amount"] = BaseModel::fromCents(m_latest.amount);
+    transaction["date"] = BaseModel::dayToString(m_latest.day);
+    return transaction;
+}
+
+void LedgerAnalytics::rebuild()
+{
+    m_weeks.clear();
+    m_months.clear();
+
+    if (m_model) {
+        for (int entry = 0; entry < m_model->entryCount(); ++entry) {
+            qint64 day = m_model->entryData(entry, TransactionModel::DayRole).toLongLong();
+            qint64 cents = BaseModel::toCents(m_model->entryData(entry, TransactionModel::AmountRole).toDouble());
+            addToBuckets(cents, day);
+        }
+    }
+
+    findLatest();
+    emit totalsChanged();
+}
+
+void LedgerAnalytics::onTransactionInserted(const QString &description, double amount, qint64 day)
+{
+    qint64 cents = BaseModel::toCents(amount);
+    addToBuckets(cents, day);
+    emit totalsChanged();
+
+    // Ties go to the newest entry
+    if (day > 0 && day >= m_latest.day) {
+        m_latest = {description, cents, day};
+        emit lastTransactionChanged();
+    }
+}
+
+void LedgerAnalytics::onTransactionRemoved(const QString &description, double amount, qint64 day)
+{
+    qint64 cents = BaseModel::toCents(amount);
+    addToBuckets(-cents, day);
+    emit totalsChanged();
+
+    // Only losing the latest entry needs a scan to find the next one
+    if (day == m_latest.day && cents == m_latest.amount && description == m_latest.description) {
+        findLatest();
+    }
+}
+
+void LedgerAnalytics::addToBuckets(qint64 cents, qint64 day)
+{
+    if (day <= 0)
+        return;
+
+    m_weeks[day - day % 7] += cents;
+    m_months[monthKey(QDate::fromJulianDay(day))] += cents;
+}
+
+void LedgerAnalytics::findLatest()
+{
+    m_latest = Latest();
+
+    if (m_model) {
+        for (int entry = 0; entry < m_model->entryCount(); ++entry) {
+            qint64 day = m_model->entryData(entry, TransactionModel::DayRole).toLongLong();
+            if (day > 0 && day >= m_latest.day) {
+                m_latest.day = day;
+                m_latest.amount = BaseModel::toCents(m_model->entryData(entry, TransactionModel::AmountRole).toDouble());
+                m_latest.description = m_model->entryData(entry, TransactionModel::DescriptionRole).toString();
+            }
+        }
+    }
+
+    emit lastTransactionChanged();
+}
@@ -0,0 +1,171 @@
+#include "ledgerindex.h"
+
+static const qint64 MinimumWindow = 64;
+// About 45 years, far more than a ledger spans but only 128 KiB per array
+static const qint64 MaximumWindow = 16384;
+// Outlying days tolerated before the window moves to where most days are
+static const int MinimumOutlierLimit = 64;
+
+LedgerIndex::LedgerIndex()
+    : m_firstDay(0)
+    , m_undated(0)
+    , m_total(0)
+    , m_outlierLimit(MinimumOutlierLimit)
+{
+}
+
+void LedgerIndex::clear()
+{
+    m_firstDay = 0;
+    m_undated = 0;
+    m_total = 0;
+    m_values.clear();
+    m_tree.clear();
+    m_outliers.clear();
+    m_outlierLimit = MinimumOutlierLimit;
+}
+
+void LedgerIndex::add(qint64 day, qint64 cents)
+{
+    m_total += cents;
+
+    if (day <= 0) {
+        m_undated += cents;
+        return;
+    }
+
+    if (!cover(day)) {
+        qint64 &amount = m_outliers[day];
+        amount += cents;
+        if (amount == 0) {
+            m_outliers.remove(day);
+        } else if (m_outliers.size() >= m_outlierLimit) {
+            relocate();
+        }
+        return;
+    }
+
+    // A day may have amounts in both places if the window grew over it, sums add them up
+    qint64 position = day - m_firstDay;
+    m_values[position] += cents;
+    for (qint64 i = position + 1; i < m_tree.size(); i += i & -i) {
+        m_tree[i] += cents;
+    }
+}
+
+qint64 LedgerIndex::sumThrough(qint64 day) const
+{
+    if (day <= 0)
+        return m_undated;
+
+    qint64 sum = m_undated;
+    for (auto it = m_outliers.cbegin(); it != m_outliers.cend() && it.key() <= day; ++it) {
+        sum += it.value();
+    }
+
+    if (m_values.isEmpty() || day < m_firstDay)
+        return sum;
+
+    for (qint64 i = qMin(day - m_firstDay + 1, qint64(m_values.size())); i > 0; i -= i & -i) {
+        sum += m_tree.at(i);
+    }
+    return sum;
+}
+
+qint64 LedgerIndex::sumBetween(qint64 firstDay, qint64 lastDay) const
+{
+    if (lastDay < firstDay)
+        return 0;
+
+    return sumThrough(lastDay) - sumThrough(firstDay - 1);
+}
+
+bool LedgerIndex::cover(qint64 day)
+{
+    if (!m_values.isEmpty() && day >= m_firstDay && day < m_firstDay + m_values.size())
+        return true;
+
+    // Grow the window geometrically so a ledger spreading over time stays amortized O(1) per day
+    qint64 first = m_values.isEmpty() ? day : qMin(m_firstDay, day);
+    qint64 last = m_values.isEmpty() ? day : qMax(m_firstDay + m_values.size() - 1, day);
+    if (last - first + 1 > MaximumWindow)
+        return false;
+
+    qint64 size = qMin(MaximumWindow, qMax(MinimumWindow, qMax(last - first + 1, qint64(m_values.size()) * 2)));
+    if (day < m_firstDay) {
+        first = last - size + 1;
+    }
+
+    QList<qint64> values(size, 0);
+    for (qint64 i = 0; i < m_values.size(); ++i) {
+        values[m_firstDay + i - first] = m_values.at(i);
+    }
+
+    build(first, values);
+    return true;
+}
+
+void LedgerIndex::relocate()
+{
+    // Every dated amount in day order, wherever it is kept
+    QMap<qint64, qint64> days = m_outliers;
+    for (qint64 i = 0; i < m_values.size(); ++i) {
+        if (m_values.at(i) != 0) {
+            days[m_firstDay + i] += m_values.at(i);
+        }
+    }
+    const QList<qint64> keys = days.keys();
+
+    // The window goes where it covers the most days
+    qsizetype bestStart = 0;
+    qsizetype bestCount = 0;
+    for (qsizetype start = 0, end = 0; start < keys.size(); ++start) {
+        while (end < keys.size() && keys.at(end) - keys.at(start) < MaximumWindow) {
+            ++end;
+        }
+        if (end - start > bestCount) {
+            bestStart = start;
+            bestCount = end - start;
+        }
+    }
+
+    m_outliers.clear();
+    if (keys.isEmpty()) {
+        m_values.clear();
+        m_tree.clear();
+    } else {
+        qint64 first = keys.at(bestStart);
+        qint64 last = keys.at(bestStart + bestCount - 1);
+        QList<qint64> values(qMax(MinimumWindow, last - first + 1), 0);
+        for (auto it = days.cbegin(); it != days.cend(); ++it) {
+            if (it.key() >= first && it.key() <= last) {
+                values[it.key() - first] = it.value();
+            } else {
+                m_outliers.insert(it.key(), it.value());
+            }
+        }
+        build(first, values);
+    }
+
+    // Grows with what stays outside, so a ledger that really spans centuries does not relocate on every add
+    m_outlierLimit = qMax(MinimumOutlierLimit, int(m_outliers.size()) * 2);
+}
+
+void LedgerIndex::build(qint64 firstDay, const QList<qint64> &values)
+{
+    qint64 size = values.size();
+
+    // Linear-time Fenwick construction
+    QList<qint64> tree(size + 1, 0);
+    for (qint64 i = 1; i <= size; ++i) {
+        tree[i] += values.at(i - 1);
+        qint64 parent = i + (i & -i);
+        if (parent <= size) {
+            tree[parent] += tree.at(i);
+        }
+    }
+
+    m_firstDay = firstDay;
+    m_values = values;
+    m_tree = tree;
+}
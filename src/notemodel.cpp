@@ -4,6 +4,8 @@ NoteModel::NoteModel(QObject *parent)
     : BaseModel("notes.json", parent)
     , m_content("")
 {
+    // Content is pushed on every keystroke, give typing a wider window
+    setSaveDelay(1000);
 }
 
 int NoteModel::rowCount(const QModelIndex &parent) const
@@ -40,17 +40,12 @@ QHash<int, QByteArray> OfferModel::roleNames() const
 
 void OfferModel::addOffer(const QString &name, int price)
 {
-    beginInsertRows(QModelIndex(), m_offers.size(), m_offers.size());
-    m_offers.append({name, price});
-    endInsertRows();
-
-    // Sort after adding
-    beginResetModel();
-    performSort();
-    endResetModel();
+    Offer offer{name, price};
+    updateSortKey(offer);
+    int row = insertSorted(m_offers, offer, &OfferModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void OfferModel::updateOffer(int index, const QString &name, int price)
@@ -58,14 +53,12 @@ void OfferModel::updateOffer(int index, const QString &name, int price)
     if (index < 0 || index >= m_offers.size())
         return;
 
-    m_offers[index] = {name, price};
-
-    // Resort after updating
-    beginResetModel();
-    performSort();
-    endResetModel();
-    emit priceDataChanged();
-    saveToFile();
+    QJsonObject before = entryToJson(index);
+    Offer offer{name, price};
+    updateSortKey(offer);
+    int row = updateSorted(m_offers, index, offer, &OfferModel::lessThan);
+    recordUpdate(before, row);
+    emit priceDataChanged(qMin(index, row), qMax(index, row));
 }
 
 QString OfferModel::getOfferName(int index) const
@@ -86,23 +79,27 @@ int OfferModel::getOfferPrice(int index) const
 
 void OfferModel::performSort()
 {
-    std::sort(m_offers.begin(), m_offers.end(), [this](const Offer &a, const Offer &b) {
-        bool result = false;
+    sortRows(m_offers, &OfferModel::lessThan, &OfferModel::updateSortKey);
+}
 
-        switch (m_sortColumn) {
-        case SortByName:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        case SortByPrice:
-            result = a.price < b.price;
-            break;
-        default:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        }
+bool OfferModel::lessThan(const Offer &a, const Offer &b) const
+{
+    switch (m_sortColumn) {
+    case SortByPrice:
+        return a.price < b.price;
+    case SortByName:
+    default:
+        return a.sortKey < b.sortKey;
+    }
+}
 
-        return m_sortAscending ? result : !result;
-    });
+void OfferModel::updateSortKey(Offer &offer) const
+{
+    if (m_sortColumn == SortByPrice) {
+        offer.sortKey.clear();
+    } else {
+        offer.sortKey = offer.name.toCaseFolded();
+    }
 }
 
 QJsonObject OfferModel::entryToJson(int index) const
@@ -122,6 +119,7 @@ void OfferModel::entryFromJson(const QJsonObject &obj)
     Offer off;
     off.name = obj["name"].toString();
     off.price = obj["price"].toInt();
+    updateSortKey(off);
     m_offers.append(off);
 }
 
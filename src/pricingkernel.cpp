@@ -0,0 +1,79 @@
+#include "pricingkernel.h"
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+// Clients per block; totals for a block stay in L1 while every supplement is added
+static const int BlockSize = 1024;
+
+// Below this a single thread is faster than handing blocks out
+static const int ParallelThreshold = 32768;
+
+QList<int> PricingKernel::price(const PriceTable &table, const Columns &columns)
+{
+    QList<int> prices(columns.count, 0);
+    int *out = prices.data();
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    if (columns.count < ParallelThreshold || threads == 1) {
+        priceRange(table, columns, 0, columns.count, out);
+        return prices;
+    }
+
+    // Whole blocks per task so no two tasks write the same cache line
+    int blocks = (columns.count + BlockSize - 1) / BlockSize;
+    int blocksPerTask = (blocks + threads - 1) / threads;
+    int tasks = 0;
+
+    QSemaphore done;
+    for (int firstBlock = 0; firstBlock < blocks; firstBlock += blocksPerTask) {
+        int first = firstBlock * BlockSize;
+        int last = qMin(columns.count, (firstBlock + blocksPerTask) * BlockSize);
+        ++tasks;
+        QThreadPool::globalInstance()->start([&table, &columns, first, last, out, &done]() {
+            priceRange(table, columns, first, last, out);
+            done.release();
+        });
+    }
+    done.acquire(tasks);
+
+    return prices;
+}
+
+void PricingKernel::priceRange(const PriceTable &table, const Columns &columns, int first, int last, int *prices)
+{
+    const int offerCount = table.offerPrices.size();
+    const int supplementCount = qMin(int(table.supplementPrices.size()),
+                                     columns.count > 0 ? int(columns.quantities.size() / columns.count) : 0);
+    const int *offers = columns.offers.constData();
+    const int *discounts = columns.discounts.constData();
+    const quint16 *quantities = columns.quantities.constData();
+
+    for (int blockStart = first; blockStart < last; blockStart += BlockSize) {
+        int blockEnd = qMin(last, blockStart + BlockSize);
+        int *totals = prices + blockStart;
+        int size = blockEnd - blockStart;
+
+        // Offer ids outside the table price at 0, like an unknown offer row
+        for (int i = 0; i < size; ++i) {
+            int offer = offers[blockStart + i];
+            totals[i] = (offer >= 0 && offer < offerCount) ? table.offerPrices.at(offer) : 0;
+        }
+
+        for (int supplement = 0; supplement < supplementCount; ++supplement) {
+            int unitPrice = table.supplementPrices.at(supplement);
+            if (unitPrice == 0)
+                continue;
+
+            const quint16 *column = quantities + qsizetype(supplement) * columns.count + blockStart;
+            for (int i = 0; i < size; ++i) {
+                totals[i] += unitPrice * column[i];
+            }
+        }
+
+        for (int i = 0; i < size; ++i) {
+            totals[i] = totals[i] * (100 - discounts[blockStart + i]) / 100;
+        }
+    }
+}
@@ -3,6 +3,12 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QSettings>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QDebug>
 
 RemoteDatabaseManager* RemoteDatabaseManager::m_instance = nullptr;
@@ -90,6 +96,17 @@ void RemoteDatabaseManager::makeRequest(const QString &method, const QString &en
     QNetworkReply *reply = nullptr;
 
     if (method == "GET") {
+        // Loads are idempotent, the startup burst can share one connection
+        request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+
+        if (endpoint.startsWith("/api/load/")) {
+            QString cacheKey = loadCacheKey(endpoint.split("/").last());
+            CachedLoad cached = cachedLoad(cacheKey);
+            if (!cached.etag.isEmpty()) {
+                request.setRawHeader("If-None-Match", cached.etag);
+            }
+        }
+
         reply = m_networkManager->get(request);
     } else if (method == "POST") {
         QJsonDocument doc(data);
@@ -109,9 +126,10 @@ void RemoteDatabaseManager::handleNetworkReply()
 
     QString endpoint = reply->property("endpoint").toString();
     QByteArray responseData = reply->readAll();
+    int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
     qDebug() << "Network reply for endpoint:" << endpoint;
-    qDebug() << "HTTP status:" << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qDebug() << "HTTP status:" << httpStatus;
 
     reply->deleteLater();
 
@@ -127,12 +145,34 @@ void RemoteDatabaseManager::handleNetworkReply()
         return;
     }
 
+    QString loadKey;
+    if (endpoint.contains("/load/")) {
+        loadKey = loadCacheKey(endpoint.split("/").last());
+
+        if (httpStatus == 304) {
+            // Unchanged since the cached load, reuse its payload
+            qDebug() << "Collection not modified, using cached payload";
+            responseData = cachedLoad(loadKey).payload;
+        } else {
+            QByteArray etag = reply->rawHeader("ETag");
+            if (!etag.isEmpty()) {
+                storeCachedLoad(loadKey, {etag, responseData});
+            }
+        }
+    }
+
     QJsonParseError parseError;
     QJsonDocument doc = QJsonDocument::fromJson(responseData, &parseError);
 
     if (parseError.error != QJsonParseError::NoError) {
         qWarning() << "JSON parse error:" << parseError.errorString();
         qWarning() << "Response was:" << responseData;
+
+        // A broken cache entry would be validated again forever, forget it and load in full
+        if (httpStatus == 304) {
+            dropCachedLoad(loadKey);
+            loadData(endpoint.split("/").last());
+        }
         return;
     }
 
@@ -167,3 +207,71 @@ void RemoteDatabaseManager::handleNetworkReply()
         emit dataLoaded(collection, response);
     }
 }
+
+QString RemoteDatabaseManager::loadCacheKey(const QString &collection) const
+{
+    // A cached load is only valid for the server and user it came from
+    QSettings settings("Odizinne", "GTACOMPTA");
+    QString host = settings.value("remoteHost", "localhost").toString();
+    QString username = settings.value("remoteUsername", "").toString();
+
+    return QString("%1\n%2\n%3").arg(host, username, collection);
+}
+
+QString RemoteDatabaseManager::loadCacheFilePath(const QString &key) const
+{
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/remote";
+    QByteArray name = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return cacheDir + "/" + QString::fromLatin1(name) + ".cache";
+}
+
+RemoteDatabaseManager::CachedLoad RemoteDatabaseManager::cachedLoad(const QString &key)
+{
+    auto it = m_loadCache.constFind(key);
+    if (it != m_loadCache.constEnd())
+        return it.value();
+
+    // Entries outlive the session, the first load after a restart is validated too.
+    // The file holds the ETag on its first line, then the payload.
+    CachedLoad cached;
+    QFile file(loadCacheFilePath(key));
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray content = file.readAll();
+        file.close();
+
+        qsizetype newline = content.indexOf('\n');
+        if (newline > 0) {
+            cached.etag = content.left(newline);
+            cached.payload = content.mid(newline + 1);
+        }
+    }
+
+    m_loadCache.insert(key, cached);
+    return cached;
+}
+
+void RemoteDatabaseManager::storeCachedLoad(const QString &key, const CachedLoad &cached)
+{
+    m_loadCache.insert(key, cached);
+
+    QString filePath = loadCacheFilePath(key);
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open load cache for writing:" << filePath;
+        return;
+    }
+
+    file.write(cached.etag + "\n");
+    file.write(cached.payload);
+    if (!file.commit()) {
+        qWarning() << "Failed to write load cache:" << filePath;
+    }
+}
+
+void RemoteDatabaseManager::dropCachedLoad(const QString &key)
+{
+    m_loadCache.insert(key, CachedLoad());
+    QFile::remove(loadCacheFilePath(key));
+}
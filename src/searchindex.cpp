@@ -0,0 +1,225 @@
+#include "searchindex.h"
+#include <algorithm>
+
+// Rows checked between two looks at the cancel flag
+static const qsizetype ChunkSize = 4096;
+
+static QList<quint64> trigrams(const QString &text)
+{
+    QList<quint64> keys;
+    if (text.size() < 3)
+        return keys;
+
+    keys.reserve(text.size() - 2);
+    for (qsizetype i = 0; i + 2 < text.size(); ++i) {
+        keys.append(quint64(text.at(i).unicode()) << 32
+                    | quint64(text.at(i + 1).unicode()) << 16
+                    | quint64(text.at(i + 2).unicode()));
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+static QList<quint32> intersect(const QList<quint32> &a, const QList<quint32> &b)
+{
+    QList<quint32> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+SearchIndex::SearchIndex(QAbstractItemModel *model, const TextProvider &textProvider, QObject *parent)
+    : QObject(parent)
+    , m_model(model)
+    , m_textProvider(textProvider)
+    , m_nextId(0)
+{
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, &SearchIndex::onRowsInserted);
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, &SearchIndex::onRowsRemoved);
+    connect(m_model, &QAbstractItemModel::rowsMoved, this, &SearchIndex::onRowsMoved);
+    connect(m_model, &QAbstractItemModel::dataChanged, this, &SearchIndex::onDataChanged);
+    connect(m_model, &QAbstractItemModel::modelReset, this, &SearchIndex::rebuild);
+    connect(m_model, &QAbstractItemModel::layoutChanged, this, &SearchIndex::rebuild);
+
+    rebuild();
+}
+
+QList<quint32> SearchIndex::search(const Snapshot &data, const QString &needle, const CancelCheck &cancelled)
+{
+    QList<quint32> result;
+    qsizetype checked = 0;
+
+    QList<quint64> keys = trigrams(needle);
+    if (keys.isEmpty()) {
+        // Too short to use the postings, the folded texts are still cheap to scan
+        for (auto it = data.texts.begin(); it != data.texts.end(); ++it) {
+            if (++checked % ChunkSize == 0 && cancelled && cancelled())
+                return {};
+
+            if (it.value().contains(needle)) {
+                result.append(it.key());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    QList<const QList<quint32> *> lists;
+    for (quint64 key : keys) {
+        auto it = data.postings.constFind(key);
+        if (it == data.postings.constEnd())
+            return result;
+        lists.append(&it.value());
+    }
+
+    // Start from the rarest trigram so the candidate set shrinks fastest
+    std::sort(lists.begin(), lists.end(), [](const QList<quint32> *a, const QList<quint32> *b) {
+        return a->size() < b->size();
+    });
+
+    QList<quint32> candidates = *lists.first();
+    for (qsizetype i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        if (cancelled && cancelled())
+            return {};
+        candidates = intersect(candidates, *lists.at(i));
+    }
+
+    // Trigrams can match out of order, confirm against the text
+    for (quint32 id : candidates) {
+        if (++checked % ChunkSize == 0 && cancelled && cancelled())
+            return {};
+
+        if (data.texts.value(id).contains(needle)) {
+            result.append(id);
+        }
+    }
+    return result;
+}
+
+QList<quint32> SearchIndex::refine(const Snapshot &data, const QString &needle, const QList<quint32> &candidates,
+                                   quint32 since, const CancelCheck &cancelled)
+{
+    QList<quint32> result;
+    qsizetype checked = 0;
+
+    // Removed or re-indexed rows have no text anymore and drop out here
+    for (quint32 id : candidates) {
+        if (++checked % ChunkSize == 0 && cancelled && cancelled())
+            return {};
+
+        auto it = data.texts.constFind(id);
+        if (it != data.texts.constEnd() && it.value().contains(needle)) {
+            result.append(id);
+        }
+    }
+
+    for (quint32 id = since; id < data.nextId; ++id) {
+        if (++checked % ChunkSize == 0 && cancelled && cancelled())
+            return {};
+
+        auto it = data.texts.constFind(id);
+        if (it != data.texts.constEnd() && it.value().contains(needle)) {
+            result.append(id);
+        }
+    }
+    return result;
+}
+
+void SearchIndex::rebuild()
+{
+    m_rowIds.clear();
+    m_texts.clear();
+    m_postings.clear();
+
+    int rows = m_model->rowCount();
+    m_rowIds.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        m_rowIds.append(addText(m_textProvider(row).toCaseFolded()));
+    }
+
+    emit rebuilt();
+    emit updated();
+}
+
+void SearchIndex::onRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    for (int row = first; row <= last; ++row) {
+        m_rowIds.insert(row, addText(m_textProvider(row).toCaseFolded()));
+    }
+    emit updated();
+}
+
+void SearchIndex::onRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    for (int row = first; row <= last; ++row) {
+        removeText(m_rowIds.at(row));
+    }
+    m_rowIds.remove(first, last - first + 1);
+    emit updated();
+}
+
+void SearchIndex::onRowsMoved(const QModelIndex &parent, int first, int last, const QModelIndex &destination, int row)
+{
+    if (parent.isValid() || destination.isValid())
+        return;
+
+    QList<quint32> moved = m_rowIds.mid(first, last - first + 1);
+    m_rowIds.remove(first, moved.size());
+
+    int target = row > first ? row - moved.size() : row;
+    for (qsizetype i = 0; i < moved.size(); ++i) {
+        m_rowIds.insert(target + i, moved.at(i));
+    }
+    emit updated();
+}
+
+void SearchIndex::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < m_rowIds.size(); ++row) {
+        QString text = m_textProvider(row).toCaseFolded();
+        if (text == m_texts.value(m_rowIds.at(row)))
+            continue;
+
+        removeText(m_rowIds.at(row));
+        m_rowIds[row] = addText(text);
+    }
+    emit updated();
+}
+
+quint32 SearchIndex::addText(const QString &folded)
+{
+    quint32 id = m_nextId++;
+
+    for (quint64 key : trigrams(folded)) {
+        m_postings[key].append(id);
+    }
+    m_texts.insert(id, folded);
+    return id;
+}
+
+void SearchIndex::removeText(quint32 id)
+{
+    QString folded = m_texts.take(id);
+
+    for (quint64 key : trigrams(folded)) {
+        auto it = m_postings.find(key);
+        if (it == m_postings.end())
+            continue;
+
+        QList<quint32> &ids = it.value();
+        auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+        if (pos != ids.end() && *pos == id) {
+            ids.erase(pos);
+        }
+        if (ids.isEmpty()) {
+            m_postings.erase(it);
+        }
+    }
+}
@@ -40,17 +40,12 @@ QHash<int, QByteArray> SupplementModel::roleNames() const
 
 void SupplementModel::addSupplement(const QString &name, int price)
 {
-    beginInsertRows(QModelIndex(), m_supplements.size(), m_supplements.size());
-    m_supplements.append({name, price});
-    endInsertRows();
-
-    // Sort after adding
-    beginResetModel();
-    performSort();
-    endResetModel();
+    Supplement supplement{name, price};
+    updateSortKey(supplement);
+    int row = insertSorted(m_supplements, supplement, &SupplementModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
 }
 
 void SupplementModel::updateSupplement(int index, const QString &name, int price)
@@ -58,14 +53,12 @@ void SupplementModel::updateSupplement(int index, const QString &name, int price
     if (index < 0 || index >= m_supplements.size())
         return;
 
-    m_supplements[index] = {name, price};
-
-    // Resort after updating
-    beginResetModel();
-    performSort();
-    endResetModel();
-    emit priceDataChanged();
-    saveToFile();
+    QJsonObject before = entryToJson(index);
+    Supplement supplement{name, price};
+    updateSortKey(supplement);
+    int row = updateSorted(m_supplements, index, supplement, &SupplementModel::lessThan);
+    recordUpdate(before, row);
+    emit priceDataChanged(qMin(index, row), qMax(index, row));
 }
 
 QString SupplementModel::getSupplementName(int index) const
@@ -86,23 +79,27 @@ int SupplementModel::getSupplementPrice(int index) const
 
 void SupplementModel::performSort()
 {
-    std::sort(m_supplements.begin(), m_supplements.end(), [this](const Supplement &a, const Supplement &b) {
-        bool result = false;
+    sortRows(m_supplements, &SupplementModel::lessThan, &SupplementModel::updateSortKey);
+}
 
-        switch (m_sortColumn) {
-        case SortByName:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        case SortByPrice:
-            result = a.price < b.price;
-            break;
-        default:
-            result = a.name.toLower() < b.name.toLower();
-            break;
-        }
+bool SupplementModel::lessThan(const Supplement &a, const Supplement &b) const
+{
+    switch (m_sortColumn) {
+    case SortByPrice:
+        return a.price < b.price;
+    case SortByName:
+    default:
+        return a.sortKey < b.sortKey;
+    }
+}
 
-        return m_sortAscending ? result : !result;
-    });
+void SupplementModel::updateSortKey(Supplement &supplement) const
+{
+    if (m_sortColumn == SortByPrice) {
+        supplement.sortKey.clear();
+    } else {
+        supplement.sortKey = supplement.name.toCaseFolded();
+    }
 }
 
 QJsonObject SupplementModel::entryToJson(int index) const
@@ -122,6 +119,7 @@ void SupplementModel::entryFromJson(const QJsonObject &obj)
     Supplement supp;
     supp.name = obj["name"].toString();
     supp.price = obj["price"].toInt();
+    updateSortKey(supp);
     m_supplements.append(supp);
 }
 
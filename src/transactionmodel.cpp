@@ -2,32 +2,59 @@
 #include <QDate>
 #include <algorithm>
 
+// Rows handed to views per fetch, newest first
+static const int PageSize = 500;
+
+// Slots of the decoded row cache, about two screens of delegates
+static const int RowCacheSize = 256;
+
 TransactionModel::TransactionModel(QObject *parent)
     : BaseModel("transactions.json", parent)
+    , m_rowCache(RowCacheSize)
+    , m_ledgerIndexValid(false)
 {
     m_sortColumn = SortByDate;
+    m_sortAscending = false;
+    setPageSize(PageSize);
 }
 
 int TransactionModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
+    return fetchedCount();
+}
+
+int TransactionModel::entryCount() const
+{
+    if (isSnapshotMapped())
+        return mappedRecordCount();
     return m_transactions.size();
 }
 
 QVariant TransactionModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= m_transactions.size())
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    return entryData(index.row(), role);
+}
+
+QVariant TransactionModel::entryData(int entry, int role) const
+{
+    if (entry < 0 || entry >= entryCount())
         return QVariant();
 
-    const Transaction &transaction = m_transactions.at(index.row());
+    const Transaction transaction = transactionAt(entry);
 
     switch (role) {
     case DescriptionRole:
         return transaction.description;
     case AmountRole:
-        return transaction.amount;
+        return fromCents(transaction.amount);
     case DateRole:
-        return transaction.date;
+        return dayToString(transaction.day, transaction.unparsedDate);
+    case DayRole:
+        return transaction.day;
     default:
         return QVariant();
     }
@@ -39,89 +66,348 @@ QHash<int, QByteArray> TransactionModel::roleNames() const
     roles[DescriptionRole] = "description";
     roles[AmountRole] = "amount";
     roles[DateRole] = "date";
+    roles[DayRole] = "day";
     return roles;
 }
 
+bool TransactionModel::filterKey(int row, int role, qint64 *key) const
+{
+    if (row < 0 || row >= entryCount())
+        return false;
+
+    Transaction transaction = transactionAt(row);
+    switch (role) {
+    case AmountRole:
+        *key = transaction.amount;
+        return true;
+    case DateRole:
+    case DayRole:
+        *key = transaction.day;
+        return true;
+    default:
+        return false;
+    }
+}
+
+qint64 TransactionModel::filterKeyFromValue(int role, const QVariant &value) const
+{
+    switch (role) {
+    case AmountRole:
+        return toCents(value.toDouble());
+    case DateRole:
+    case DayRole:
+        return value.typeId() == QMetaType::QString ? dayFromString(value.toString()) : value.toLongLong();
+    default:
+        return BaseModel::filterKeyFromValue(role, value);
+    }
+}
+
 void TransactionModel::addTransaction(const QString &description, double amount, const QString &date)
 {
-    beginInsertRows(QModelIndex(), m_transactions.size(), m_transactions.size());
-    m_transactions.append({description, amount, date});
-    endInsertRows();
+    materialize();
 
-    beginResetModel();
-    performSort();
-    endResetModel();
+    Transaction transaction{description, toCents(amount), 0};
+    transaction.day = dayFromString(date, &transaction.unparsedDate);
+    updateSortKey(transaction);
+    if (m_ledgerIndexValid) {
+        m_ledgerIndex.add(transaction.day, transaction.amount);
+    }
+    int row = insertSorted(m_transactions, transaction, &TransactionModel::lessThan);
+    recordInsert(row);
 
     emit countChanged();
-    saveToFile();
+    emit transactionAdded(description, fromCents(transaction.amount));
+    emit transactionInserted(description, fromCents(transaction.amount), transaction.day);
 }
 
 void TransactionModel::updateTransaction(int index, const QString &description, double amount, const QString &date)
 {
-    if (index < 0 || index >= m_transactions.size())
+    if (index < 0 || index >= rowCount())
         return;
 
-    m_transactions[index] = {description, amount, date};
+    materialize();
 
-    beginResetModel();
-    performSort();
-    endResetModel();
+    QJsonObject before = entryToJson(index);
+    Transaction previous = m_transactions.at(index);
+    Transaction transaction{description, toCents(amount), 0};
+    transaction.day = dayFromString(date, &transaction.unparsedDate);
+    updateSortKey(transaction);
+    if (m_ledgerIndexValid) {
+        m_ledgerIndex.add(previous.day, -previous.amount);
+        m_ledgerIndex.add(transaction.day, transaction.amount);
+    }
+    int row = updateSorted(m_transactions, index, transaction, &TransactionModel::lessThan);
+    recordUpdate(before, row);
 
-    saveToFile();
+    emit transactionRemoved(previous.description, fromCents(previous.amount), previous.day);
+    emit transactionInserted(description, fromCents(transaction.amount), transaction.day);
 }
 
 double TransactionModel::getTransactionAmount(int index) const
 {
-    if (index < 0 || index >= m_transactions.size())
+    if (index < 0 || index >= entryCount())
         return 0.0;
 
-    return m_transactions.at(index).amount;
+    return fromCents(transactionAt(index).amount);
 }
 
-void TransactionModel::performSort()
+double TransactionModel::ledgerBalance() const
 {
-    std::stable_sort(m_transactions.begin(), m_transactions.end(), [this](const Transaction &a, const Transaction &b) {
-        bool result = false;
-
-        switch (m_sortColumn) {
-        case SortByDescription:
-            result = a.description.toLower() < b.description.toLower();
-            break;
-        case SortByAmount:
-            result = a.amount < b.amount;
-            break;
-        case SortByDate:
-            result = a.date < b.date;
-            break;
-        default:
-            result = a.date < b.date;
-            break;
+    return fromCents(ledgerIndex().total());
+}
+
+double TransactionModel::balanceAt(const QString &date) const
+{
+    return fromCents(ledgerIndex().sumThrough(dayFromString(date)));
+}
+
+double TransactionModel::totalBetween(const QString &firstDate, const QString &lastDate) const
+{
+    return fromCents(ledgerIndex().sumBetween(dayFromString(firstDate), dayFromString(lastDate)));
+}
+
+QVariantList TransactionModel::balanceHistory(const QString &firstDate, const QString &lastDate, int stepDays) const
+{
+    QVariantList history;
+    qint64 firstDay = dayFromString(firstDate);
+    qint64 lastDay = dayFromString(lastDate);
+    if (firstDay <= 0 || lastDay < firstDay)
+        return history;
+
+    const LedgerIndex &index = ledgerIndex();
+    stepDays = qMax(1, stepDays);
+    for (qint64 day = firstDay; day <= lastDay; day += stepDays) {
+        QVariantMap point;
+        point["date"] = dayToString(day);
+        point["balance"] = fromCents(index.sumThrough(day));
+        history.append(point);
+    }
+    return history;
+}
+
+const LedgerIndex &TransactionModel::ledgerIndex() const
+{
+    // Built on first use after a reset, then kept current by every edit
+    if (!m_ledgerIndexValid) {
+        m_ledgerIndex.clear();
+        for (int i = 0; i < entryCount(); ++i) {
+            Transaction transaction = transactionAt(i);
+            m_ledgerIndex.add(transaction.day, transaction.amount);
         }
+        m_ledgerIndexValid = true;
+    }
+    return m_ledgerIndex;
+}
+
+TransactionModel::Transaction TransactionModel::transactionFromJson(const QJsonObject &obj)
+{
+    Transaction trans;
+    trans.description = obj["description"].toString();
+    trans.amount = toCents(obj["amount"].toDouble());
+    trans.day = dayFromString(obj["date"].toString(), &trans.unparsedDate);
+    return trans;
+}
+
+TransactionModel::Transaction TransactionModel::transactionAt(int index) const
+{
+    if (!isSnapshotMapped())
+        return m_transactions.at(index);
+
+    // Mapped rows are decoded on demand, only the latest ones are kept around
+    CachedRow &cached = m_rowCache[index % RowCacheSize];
+    if (cached.row != index) {
+        cached.transaction = transactionFromJson(mappedRecord(index).toObject());
+        cached.row = index;
+    }
+    return cached.transaction;
+}
+
+void TransactionModel::materialize()
+{
+    if (!isSnapshotMapped())
+        return;
+
+    QList<Transaction> transactions;
+    transactions.reserve(mappedRecordCount());
+    for (int i = 0; i < mappedRecordCount(); ++i) {
+        transactions.append(transactionFromJson(mappedRecord(i).toObject()));
+        updateSortKey(transactions.last());
+    }
 
-        return m_sortAscending ? result : !result;
-    });
+    // The file is about to be rewritten, it must not stay mapped
+    releaseSnapshot();
+    clearRowCache();
+    m_transactions = transactions;
+}
+
+void TransactionModel::clearRowCache()
+{
+    for (CachedRow &cached : m_rowCache) {
+        cached = CachedRow();
+    }
+}
+
+QString TransactionModel::monthOf(qint64 day) const
+{
+    if (day <= 0)
+        return QString();
+
+    int year = 0;
+    int month = 0;
+    QDate::fromJulianDay(day).getDate(&year, &month, nullptr);
+
+    QString &key = m_monthKeys[year * 12 + month - 1];
+    if (key.isEmpty()) {
+        key = QDate(year, month, 1).toString("yyyy-MM");
+    }
+    return key;
+}
+
+qint64 TransactionModel::dayAt(int index) const
+{
+    return isSnapshotMapped() ? transactionAt(index).day : m_transactions.at(index).day;
+}
+
+QString TransactionModel::partitionKey(const QJsonObject &entry) const
+{
+    return monthOf(dayFromString(entry["date"].toString()));
+}
+
+QString TransactionModel::entryPartition(int index) const
+{
+    return monthOf(dayAt(index));
+}
+
+bool TransactionModel::partitionSpan(const QString &key, int *begin, int *end) const
+{
+    if (m_sortColumn != SortByDate)
+        return false;
+
+    // Undated rows all have day 0
+    qint64 firstDay = 0;
+    qint64 lastDay = 0;
+    if (!key.isEmpty()) {
+        QDate month = QDate::fromString(key + "-01", Qt::ISODate);
+        if (!month.isValid())
+            return false;
+        firstDay = month.toJulianDay();
+        lastDay = month.addMonths(1).toJulianDay() - 1;
+    }
+
+    // First row whose day is past the given one in sort order
+    auto rowPast = [this](qint64 day, bool inclusive) {
+        int low = 0;
+        int high = entryCount();
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            qint64 current = dayAt(middle);
+            bool past = m_sortAscending ? (inclusive ? current >= day : current > day)
+                                        : (inclusive ? current <= day : current < day);
+            if (past) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        return low;
+    };
+
+    *begin = rowPast(m_sortAscending ? firstDay : lastDay, true);
+    *end = rowPast(m_sortAscending ? lastDay : firstDay, false);
+    return true;
+}
+
+QJsonObject TransactionModel::partitionSummary(const QList<int> &indexes) const
+{
+    qint64 income = 0;
+    qint64 expenses = 0;
+    qint64 firstDay = 0;
+    qint64 lastDay = 0;
+
+    for (int index : indexes) {
+        Transaction transaction = transactionAt(index);
+        if (transaction.amount >= 0) {
+            income += transaction.amount;
+        } else {
+            expenses += transaction.amount;
+        }
+        if (firstDay == 0 || transaction.day < firstDay)
+            firstDay = transaction.day;
+        lastDay = qMax(lastDay, transaction.day);
+    }
+
+    QJsonObject summary;
+    summary["income"] = fromCents(income);
+    summary["expenses"] = fromCents(expenses);
+    summary["total"] = fromCents(income + expenses);
+    summary["firstDate"] = dayToString(firstDay);
+    summary["lastDate"] = dayToString(lastDay);
+    return summary;
+}
+
+void TransactionModel::performSort()
+{
+    materialize();
+
+    sortRows(m_transactions, &TransactionModel::lessThan, &TransactionModel::updateSortKey);
+}
+
+bool TransactionModel::lessThan(const Transaction &a, const Transaction &b) const
+{
+    switch (m_sortColumn) {
+    case SortByDescription:
+        return a.sortKey < b.sortKey;
+    case SortByAmount:
+        return a.amount < b.amount;
+    case SortByDate:
+    default:
+        return a.day < b.day;
+    }
+}
+
+int TransactionModel::filterRoleForSortColumn(int column) const
+{
+    switch (column) {
+    case SortByAmount:
+        return AmountRole;
+    case SortByDate:
+        return DateRole;
+    default:
+        return -1;
+    }
+}
+
+void TransactionModel::updateSortKey(Transaction &transaction) const
+{
+    if (m_sortColumn == SortByDescription) {
+        transaction.sortKey = transaction.description.toCaseFolded();
+    } else {
+        transaction.sortKey.clear();
+    }
 }
 
 QJsonObject TransactionModel::entryToJson(int index) const
 {
-    if (index < 0 || index >= m_transactions.size())
+    if (index < 0 || index >= entryCount())
         return QJsonObject();
 
+    if (isSnapshotMapped())
+        return mappedRecord(index).toObject();
+
     const Transaction &trans = m_transactions.at(index);
     QJsonObject obj;
     obj["description"] = trans.description;
-    obj["amount"] = trans.amount;
-    obj["date"] = trans.date;
+    obj["amount"] = fromCents(trans.amount);
+    obj["date"] = dayToString(trans.day, trans.unparsedDate);
     return obj;
 }
 
 void TransactionModel::entryFromJson(const QJsonObject &obj)
 {
-    Transaction trans;
-    trans.description = obj["description"].toString();
-    trans.amount = obj["amount"].toDouble();
-    trans.date = obj["date"].toString();
-    m_transactions.append(trans);
+    materialize();
+    m_transactions.append(transactionFromJson(obj));
+    updateSortKey(m_transactions.last());
+    m_ledgerIndexValid = false;
 }
 
 void TransactionModel::addEntryToModel()
@@ -130,14 +416,27 @@ void TransactionModel::addEntryToModel()
 
 void TransactionModel::removeEntryFromModel(int index)
 {
+    materialize();
+
+    Transaction removed = m_transactions.at(index);
+    if (m_ledgerIndexValid) {
+        m_ledgerIndex.add(removed.day, -removed.amount);
+    }
+
     beginRemoveRows(QModelIndex(), index, index);
     m_transactions.removeAt(index);
     endRemoveRows();
+
+    emit transactionRemoved(removed.description, fromCents(removed.amount), removed.day);
 }
 
 void TransactionModel::clearModel()
 {
+    releaseSnapshot();
+    clearRowCache();
     m_transactions.clear();
+    m_ledgerIndex.clear();
+    m_ledgerIndexValid = false;
 }
 
 void TransactionModel::addTransactionFromCheckout(const QString &description, double amount)